@@ -3,33 +3,181 @@
 #include "byte_stream.hh"
 #include "eventloop.hh"
 
+#include "exception.hh"
+
+#include <array>
+#include <fcntl.h>
 #include <iostream>
+#include <span>
+#include <sys/stat.h>
 #include <unistd.h>
 
 using namespace std;
 
-void bidirectional_stream_copy( Socket& socket, string_view peer_name )
+namespace {
+constexpr size_t buffer_size = 1048576;
+constexpr size_t max_iov = 16;
+
+// A kernel pipe that one direction of the copy splices its bytes through
+struct SplicePipe
 {
-  constexpr size_t buffer_size = 1048576;
+  FileDescriptor read_end;
+  FileDescriptor write_end;
+  uint64_t bytes_in {};
+  uint64_t bytes_out {};
+  bool full {};     // the last splice into the pipe would have blocked (the kernel counts pages, not bytes)
+  bool finished {}; // the source reached EOF
+  bool shutdown {}; // the sink has been shut down
+  bool error {};
+
+  uint64_t bytes_buffered() const { return bytes_in - bytes_out; }
+};
+
+SplicePipe make_splice_pipe()
+{
+  array<int, 2> fds {};
+  CheckSystemCall( "pipe2", ::pipe2( fds.data(), O_NONBLOCK | O_CLOEXEC ) ); // NOLINT(*-signed-bitwise)
+  SplicePipe pipe { FileDescriptor { fds[0] }, FileDescriptor { fds[1] } };
+
+  // Best effort: an unprivileged process may be limited to a smaller pipe (by /proc/sys/fs/pipe-max-size).
+  fcntl( fds[1], F_SETPIPE_SZ, static_cast<int>( buffer_size ) ); // NOLINT(*-vararg)
 
+  return pipe;
+}
+
+// Copies stdin to the socket and the socket to stdout by splicing them through two kernel pipes,
+// so the bytes never pass through user space.
+void spliced_stream_copy( Socket& socket, FileDescriptor& input, FileDescriptor& output, string_view peer_name )
+{
+  EventLoop eventloop {};
+  SplicePipe outbound = make_splice_pipe();
+  SplicePipe inbound = make_splice_pipe();
+
+  const auto fail = [&] { outbound.error = inbound.error = true; };
+
+  // rule 1: splice from stdin into outbound pipe
+  eventloop.add_rule(
+    "splice from stdin into outbound pipe",
+    input,
+    Direction::In,
+    [&] {
+      const size_t moved = outbound.write_end.splice_from( input, buffer_size - outbound.bytes_buffered() );
+      outbound.bytes_in += moved;
+      outbound.full = ( moved == 0 and not input.eof() and outbound.bytes_buffered() > 0 );
+      outbound.finished = input.eof();
+    },
+    [&] {
+      return not outbound.error and not outbound.finished and not outbound.full
+             and outbound.bytes_buffered() < buffer_size;
+    },
+    [&] { outbound.finished = true; },
+    [&] {
+      cerr << "DEBUG: Outbound stream had error from source.\n";
+      fail();
+    } );
+
+  // rule 2: splice from outbound pipe into socket
+  eventloop.add_rule(
+    "splice from outbound pipe into socket",
+    socket,
+    Direction::Out,
+    [&] {
+      if ( outbound.bytes_buffered() ) {
+        const size_t moved = socket.splice_from( outbound.read_end, outbound.bytes_buffered() );
+        outbound.bytes_out += moved;
+        outbound.full &= ( moved == 0 );
+      }
+      if ( outbound.finished and not outbound.bytes_buffered() ) {
+        socket.shutdown( SHUT_WR );
+        outbound.shutdown = true;
+        cerr << "DEBUG: Outbound stream to " << peer_name << " finished.\n";
+      }
+    },
+    [&] {
+      return not outbound.error
+             and ( outbound.bytes_buffered() or ( outbound.finished and not outbound.shutdown ) );
+    },
+    [&] { outbound.finished = true; },
+    [&] {
+      cerr << "DEBUG: Outbound stream had error from destination.\n";
+      fail();
+    } );
+
+  // rule 3: splice from socket into inbound pipe
+  eventloop.add_rule(
+    "splice from socket into inbound pipe",
+    socket,
+    Direction::In,
+    [&] {
+      const size_t moved = inbound.write_end.splice_from( socket, buffer_size - inbound.bytes_buffered() );
+      inbound.bytes_in += moved;
+      inbound.full = ( moved == 0 and not socket.eof() and inbound.bytes_buffered() > 0 );
+      inbound.finished = socket.eof();
+    },
+    [&] {
+      return not inbound.error and not inbound.finished and not inbound.full
+             and inbound.bytes_buffered() < buffer_size;
+    },
+    [&] { inbound.finished = true; },
+    [&] {
+      cerr << "DEBUG: Inbound stream had error from source.\n";
+      fail();
+    } );
+
+  // rule 4: splice from inbound pipe into stdout
+  eventloop.add_rule(
+    "splice from inbound pipe into stdout",
+    output,
+    Direction::Out,
+    [&] {
+      if ( inbound.bytes_buffered() ) {
+        const size_t moved = output.splice_from( inbound.read_end, inbound.bytes_buffered() );
+        inbound.bytes_out += moved;
+        inbound.full &= ( moved == 0 );
+      }
+      if ( inbound.finished and not inbound.bytes_buffered() ) {
+        output.close();
+        inbound.shutdown = true;
+        cerr << "DEBUG: Inbound stream from " << peer_name << " finished.\n";
+      }
+    },
+    [&] {
+      return not inbound.error and ( inbound.bytes_buffered() or ( inbound.finished and not inbound.shutdown ) );
+    },
+    [&] { inbound.finished = true; },
+    [&] {
+      cerr << "DEBUG: Inbound stream had error from destination.\n";
+      fail();
+    } );
+
+  // loop until completion
+  while ( true ) {
+    if ( EventLoop::Result::Exit == eventloop.wait_next_event( -1 ) ) {
+      return;
+    }
+  }
+}
+
+// Copies stdin to the socket and the socket to stdout through a ByteStream in each direction.
+void buffered_stream_copy( Socket& socket, FileDescriptor& input, FileDescriptor& output, string_view peer_name )
+{
   EventLoop eventloop {};
-  FileDescriptor input { STDIN_FILENO };
-  FileDescriptor output { STDOUT_FILENO };
   ByteStream outbound { buffer_size };
   ByteStream inbound { buffer_size };
-  bool outbound_shutdown { false };
-  bool inbound_shutdown { false };
 
-  socket.set_blocking( false );
-  input.set_blocking( false );
-  output.set_blocking( false );
+  // Each rule is enabled and disabled by the watermark callbacks of the stream it feeds or drains
+  // (see the end of this function), instead of the event loop asking every rule whether it is interested.
 
   // rule 1: read from stdin into outbound byte stream
-  eventloop.add_rule(
+  EventLoop::RuleHandle read_stdin = eventloop.add_gated_rule(
     "read from stdin into outbound byte stream",
     input,
     Direction::In,
     [&] {
+      if ( outbound.has_error() or inbound.has_error() ) {
+        read_stdin.cancel(); // (the copy has failed: nothing more is read)
+        return;
+      }
       string data;
       data.resize( outbound.writer().available_capacity() );
       input.read( data );
@@ -38,10 +186,6 @@ void bidirectional_stream_copy( Socket& socket, string_view peer_name )
         outbound.writer().close();
       }
     },
-    [&] {
-      return !outbound.has_error() and !inbound.has_error() and ( outbound.writer().available_capacity() > 0 )
-             and !outbound.writer().is_closed();
-    },
     [&] { outbound.writer().close(); },
     [&] {
       cerr << "DEBUG: Outbound stream had error from source.\n";
@@ -50,23 +194,24 @@ void bidirectional_stream_copy( Socket& socket, string_view peer_name )
     } );
 
   // rule 2: read from outbound byte stream into socket
-  eventloop.add_rule(
+  EventLoop::RuleHandle write_socket = eventloop.add_gated_rule(
     "read from outbound byte stream into socket",
     socket,
     Direction::Out,
     [&] {
       if ( outbound.reader().bytes_buffered() ) {
-        outbound.reader().pop( socket.write( outbound.reader().peek() ) );
+        array<string_view, max_iov> views {};
+        const auto count = outbound.reader().peek_iov( views );
+        outbound.reader().pop( socket.write( span { views }.first( count ) ) );
       }
       if ( outbound.reader().is_finished() ) {
         socket.shutdown( SHUT_WR );
-        outbound_shutdown = true;
+        write_socket.cancel();
         cerr << "DEBUG: Outbound stream to " << peer_name << " finished.\n";
+      } else if ( outbound.has_error() and not outbound.reader().bytes_buffered() ) {
+        write_socket.cancel();
       }
     },
-    [&] {
-      return outbound.reader().bytes_buffered() or ( outbound.reader().is_finished() and not outbound_shutdown );
-    },
     [&] { outbound.writer().close(); },
     [&] {
       cerr << "DEBUG: Outbound stream had error from destination.\n";
@@ -75,11 +220,15 @@ void bidirectional_stream_copy( Socket& socket, string_view peer_name )
     } );
 
   // rule 3: read from socket into inbound byte stream
-  eventloop.add_rule(
+  EventLoop::RuleHandle read_socket = eventloop.add_gated_rule(
     "read from socket into inbound byte stream",
     socket,
     Direction::In,
     [&] {
+      if ( inbound.has_error() or outbound.has_error() ) {
+        read_socket.cancel();
+        return;
+      }
       string data;
       data.resize( inbound.writer().available_capacity() );
       socket.read( data );
@@ -88,10 +237,6 @@ void bidirectional_stream_copy( Socket& socket, string_view peer_name )
         inbound.writer().close();
       }
     },
-    [&] {
-      return !inbound.has_error() and !outbound.has_error() and ( inbound.writer().available_capacity() > 0 )
-             and !inbound.writer().is_closed();
-    },
     [&] { inbound.writer().close(); },
     [&] {
       cerr << "DEBUG: Inbound stream had error from source.\n";
@@ -100,24 +245,24 @@ void bidirectional_stream_copy( Socket& socket, string_view peer_name )
     } );
 
   // rule 4: read from inbound byte stream into stdout
-  eventloop.add_rule(
+  EventLoop::RuleHandle write_stdout = eventloop.add_gated_rule(
     "read from inbound byte stream into stdout",
     output,
     Direction::Out,
     [&] {
       if ( inbound.reader().bytes_buffered() ) {
-        inbound.reader().pop( output.write( inbound.reader().peek() ) );
+        array<string_view, max_iov> views {};
+        const auto count = inbound.reader().peek_iov( views );
+        inbound.reader().pop( output.write( span { views }.first( count ) ) );
       }
       if ( inbound.reader().is_finished() ) {
         output.close();
-        inbound_shutdown = true;
         cerr << "DEBUG: Inbound stream from " << peer_name << " finished"
              << ( inbound.has_error() ? " uncleanly.\n" : ".\n" );
+      } else if ( inbound.has_error() and not inbound.reader().bytes_buffered() ) {
+        write_stdout.cancel();
       }
     },
-    [&] {
-      return inbound.reader().bytes_buffered() or ( inbound.reader().is_finished() and not inbound_shutdown );
-    },
     [&] { inbound.writer().close(); },
     [&] {
       cerr << "DEBUG: Inbound stream had error from destination.\n";
@@ -125,6 +270,12 @@ void bidirectional_stream_copy( Socket& socket, string_view peer_name )
       inbound.set_error();
     } );
 
+  // A stream's writer is ready while it has room (and is open), and its reader while it has bytes (or is done).
+  outbound.set_writer_watermark( buffer_size, [&]( bool ready ) { read_stdin.set_enabled( ready ); } );
+  outbound.set_reader_watermark( 0, [&]( bool ready ) { write_socket.set_enabled( ready ); } );
+  inbound.set_writer_watermark( buffer_size, [&]( bool ready ) { read_socket.set_enabled( ready ); } );
+  inbound.set_reader_watermark( 0, [&]( bool ready ) { write_stdout.set_enabled( ready ); } );
+
   // loop until completion
   while ( true ) {
     if ( EventLoop::Result::Exit == eventloop.wait_next_event( -1 ) ) {
@@ -132,3 +283,40 @@ void bidirectional_stream_copy( Socket& socket, string_view peer_name )
     }
   }
 }
+} // namespace
+
+// Can splice(2) move bytes into or out of `fd`? It works with pipes, sockets and regular files (but not with
+// a file opened for appending), and not with e.g. a terminal.
+bool splice_capable( const FileDescriptor& fd )
+{
+  struct stat st {};
+  CheckSystemCall( "fstat", fstat( fd.fd_num(), &st ) );
+  const int flags = CheckSystemCall( "fcntl", fcntl( fd.fd_num(), F_GETFL ) ); // NOLINT(*-vararg)
+  const bool splice_type = S_ISFIFO( st.st_mode ) or S_ISSOCK( st.st_mode ) or S_ISREG( st.st_mode );
+  return splice_type and not( flags & O_APPEND ); // NOLINT(*-bitwise)
+}
+
+void bidirectional_stream_copy( Socket& socket, string_view peer_name )
+{
+  FileDescriptor input { STDIN_FILENO };
+  FileDescriptor output { STDOUT_FILENO };
+  bidirectional_stream_copy( socket, input, output, peer_name );
+}
+
+void bidirectional_stream_copy( Socket& socket,
+                                FileDescriptor& input,
+                                FileDescriptor& output,
+                                string_view peer_name )
+{
+  socket.set_blocking( false );
+  input.set_blocking( false );
+  output.set_blocking( false );
+
+  if ( splice_capable( socket ) and splice_capable( input ) and splice_capable( output ) ) {
+    cerr << "DEBUG: Copying with splice(2) through kernel pipes.\n";
+    spliced_stream_copy( socket, input, output, peer_name );
+  } else {
+    cerr << "DEBUG: Copying through user-space ByteStreams (the input or output can't be spliced).\n";
+    buffered_stream_copy( socket, input, output, peer_name );
+  }
+}
@@ -4,3 +4,13 @@
 
 //! Copy socket input/output to stdin/stdout until finished
 void bidirectional_stream_copy( Socket& socket, std::string_view peer_name );
+
+//! Copy socket input/output to `output`/from `input` until finished (splicing the bytes through kernel pipes if
+//! all three can be spliced, and otherwise copying them through user space)
+void bidirectional_stream_copy( Socket& socket,
+                                FileDescriptor& input,
+                                FileDescriptor& output,
+                                std::string_view peer_name );
+
+//! Can splice(2) move bytes into or out of `fd`?
+bool splice_capable( const FileDescriptor& fd );
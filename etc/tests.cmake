@@ -23,6 +23,11 @@ ttest(byte_stream_one_write)
 ttest(byte_stream_two_writes)
 ttest(byte_stream_many_writes)
 ttest(byte_stream_stress_test)
+ttest(byte_stream_wraparound)
+ttest(byte_stream_zero_copy)
+ttest(byte_stream_spsc)
+ttest(byte_stream_watermarks)
+ttest(byte_stream_spill)
 
 ttest(reassembler_single)
 ttest(reassembler_cap)
@@ -31,6 +36,11 @@ ttest(reassembler_dup)
 ttest(reassembler_holes)
 ttest(reassembler_overlapping)
 ttest(reassembler_win)
+ttest(reassembler_bitmap)
+ttest(reassembler_many)
+ttest(reassembler_limits)
+ttest(reassembler_slices)
+ttest(reassembler_stats)
 
 ttest(wrapping_integers_cmp)
 ttest(wrapping_integers_wrap)
@@ -45,6 +55,11 @@ ttest(recv_reorder)
 ttest(recv_reorder_more)
 ttest(recv_close)
 ttest(recv_special)
+ttest(recv_sack)
+ttest(recv_window_scale)
+ttest(recv_timestamps)
+ttest(recv_window_update)
+ttest(recv_burst)
 
 ttest(send_connect)
 ttest(send_transmit)
@@ -53,6 +68,16 @@ ttest(send_ack)
 ttest(send_close)
 ttest(send_retx)
 ttest(send_extra)
+ttest(send_rto)
+ttest(send_congestion)
+ttest(send_fast_retransmit)
+ttest(send_sack)
+ttest(send_pacing)
+ttest(send_persist)
+ttest(send_linger)
+ttest(tcp_in_process_streams)
+
+ttest(bidirectional_copy)
 
 ttest(net_interface)
 
@@ -94,3 +119,6 @@ set_tests_properties(${compile_name_opt} PROPERTIES FIXTURES_SETUP compile_opt)
 
 stest(byte_stream_speed_test)
 stest(reassembler_speed_test)
+stest(reassembler_adversarial_speed_test)
+stest(tcp_congestion_speed_test)
+stest(tcp_loopback_speed_test)
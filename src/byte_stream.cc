@@ -1,28 +1,192 @@
 #include "byte_stream.hh"
 
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+
 using namespace std;
 
-ByteStream::ByteStream( uint64_t capacity ) : capacity_( capacity ) {}
+namespace {
+// Residency hints are issued in steps of this many bytes, not on every push and pop
+constexpr uint64_t residency_step = 1024 * 1024;
+
+MirroredBuffer make_ring( uint64_t capacity )
+{
+  if ( capacity < ByteStream::kSpillCapacity ) {
+    return MirroredBuffer { capacity };
+  }
+  const char* tmpdir = getenv( "TMPDIR" ); // NOLINT(*-mt-unsafe)
+  return MirroredBuffer { capacity, tmpdir ? tmpdir : "/var/tmp" };
+}
+} // namespace
+
+ByteStream::ByteStream( uint64_t capacity ) : capacity_( capacity ), buffer_( make_ring( capacity ) ) {}
+
+void ByteStream::spill_adopted_to_ring()
+{
+  if ( adopted_.empty() ) {
+    return;
+  }
+  const uint64_t remaining = bytes_pushed_ - bytes_popped_;
+  buffer_.write( bytes_popped_, string_view( adopted_ ).substr( adopted_.size() - remaining ) );
+  pool_.give( exchange( adopted_, {} ) );
+}
+
+void ByteStream::manage_residency()
+{
+  if ( not buffer_.file_backed() ) {
+    return;
+  }
+
+  // Popped bytes: give back their memory and disk space (but never touch ring positions that the writer
+  // has already reused, or written ahead into)
+  const uint64_t written_to = max( bytes_pushed_, written_ahead_to_ );
+  const uint64_t discard_begin = max( discarded_to_, written_to - min( written_to, buffer_.size() ) );
+  if ( bytes_popped_ >= discard_begin + residency_step ) {
+    buffer_.discard( discard_begin, bytes_popped_ - discard_begin );
+    discarded_to_ = bytes_popped_ / residency_step * residency_step;
+  }
+
+  // The middle, between the head and the tail: write back and drop from memory
+  const uint64_t middle_begin = max( evicted_to_, bytes_popped_ + kResidentBytes );
+  const uint64_t tail_begin = bytes_pushed_ - min( bytes_pushed_, kResidentBytes );
+  const uint64_t middle_end = tail_begin / residency_step * residency_step;
+  if ( middle_end >= middle_begin + residency_step ) {
+    buffer_.evict( middle_begin, middle_end - middle_begin );
+    evicted_to_ = middle_end;
+  }
+
+  // The head: read evicted bytes back in ahead of the reader
+  const uint64_t prefetch_begin = max( prefetched_to_, bytes_popped_ );
+  const uint64_t prefetch_end = min( evicted_to_, bytes_popped_ + kResidentBytes );
+  if ( prefetch_end > prefetch_begin
+       and ( prefetch_end - prefetch_begin >= residency_step or prefetch_end == evicted_to_ ) ) {
+    buffer_.prefetch( prefetch_begin, prefetch_end - prefetch_begin );
+    prefetched_to_ = prefetch_end;
+  }
+}
+
+void ByteStream::set_error()
+{
+  error_ = true;
+  update_readiness();
+}
+
+ByteStream::Watermark& ByteStream::Watermark::operator=( const Watermark& other )
+{
+  level = other.level;
+  on_change = {};
+  ready = other.ready;
+  return *this;
+}
+
+void ByteStream::set_reader_watermark( uint64_t low_watermark, function<void( bool )> on_change )
+{
+  low_watermark_.level = low_watermark;
+  low_watermark_.on_change = move( on_change );
+  low_watermark_.ready = reader_is_ready();
+  low_watermark_.on_change( low_watermark_.ready );
+}
+
+void ByteStream::set_writer_watermark( uint64_t high_watermark, function<void( bool )> on_change )
+{
+  high_watermark_.level = high_watermark;
+  high_watermark_.on_change = move( on_change );
+  high_watermark_.ready = writer_is_ready();
+  high_watermark_.on_change( high_watermark_.ready );
+}
+
+bool ByteStream::reader_is_ready() const
+{
+  return bytes_pushed_ - bytes_popped_ > low_watermark_.level or close_ or error_;
+}
+
+bool ByteStream::writer_is_ready() const
+{
+  return bytes_pushed_ - bytes_popped_ < high_watermark_.level and not close_ and not error_;
+}
+
+void ByteStream::update_readiness()
+{
+  if ( low_watermark_.on_change and reader_is_ready() != low_watermark_.ready ) {
+    low_watermark_.ready = not low_watermark_.ready;
+    low_watermark_.on_change( low_watermark_.ready );
+  }
+  if ( high_watermark_.on_change and writer_is_ready() != high_watermark_.ready ) {
+    high_watermark_.ready = not high_watermark_.ready;
+    high_watermark_.on_change( high_watermark_.ready );
+  }
+}
 
 void Writer::push( string data )
+{
+  push( Ref<string> { move( data ) } );
+}
+
+void Writer::push( Ref<string> data )
+{
+  push( move( data ), 0 );
+}
+
+void Writer::push( Ref<string> data, uint64_t offset )
 {
   if ( is_closed() )
     return;
 
+  offset = min( offset, static_cast<uint64_t>( data.get().size() ) );
   uint64_t writable = available_capacity();
-  uint64_t write_size = min( writable, static_cast<uint64_t>( data.size() ) );
-  if ( write_size == 0 )
+  uint64_t write_size = min( writable, data.get().size() - offset );
+  if ( write_size == 0 ) {
+    if ( data.is_owned() ) {
+      pool_.give( data.release() ); // (nothing to keep, but the buffer can be used again)
+    }
     return;
+  }
 
-  buffer_.push_back( data.substr( 0, write_size ) );
-  if ( buffer_.size() == 1 )
-    buffer_view_ = buffer_.front();
+  if ( data.is_owned() and reader().bytes_buffered() == 0 and not buffer_.file_backed() ) {
+    // Nothing is waiting to be read: keep the caller's buffer instead of copying it. (The buffered bytes are
+    // its tail, so skipped bytes at the front are simply never read. A file-backed ring always copies, so that
+    // the bytes it holds can be evicted from memory.)
+    pool_.give( exchange( adopted_, data.release() ) );
+    adopted_.resize( offset + write_size );
+  } else {
+    spill_adopted_to_ring();
+    buffer_.write( bytes_pushed_, string_view( data.get() ).substr( offset, write_size ) );
+    if ( data.is_owned() ) {
+      pool_.give( data.release() ); // the bytes are in the ring now, but the buffer can be used again
+    }
+  }
   bytes_pushed_ += write_size;
+  manage_residency();
+  update_readiness();
+}
+
+void Writer::write_ahead( uint64_t offset, string_view data )
+{
+  if ( is_closed() or offset >= available_capacity() ) {
+    return;
+  }
+  data = data.substr( 0, available_capacity() - offset );
+  buffer_.write( bytes_pushed_ + offset, data );
+  written_ahead_to_ = max( written_ahead_to_, bytes_pushed_ + offset + data.size() );
+}
+
+void Writer::commit( uint64_t len )
+{
+  len = min( len, available_capacity() );
+  if ( is_closed() or len == 0 ) {
+    return;
+  }
+  spill_adopted_to_ring(); // (the adopted bytes go before the committed ones)
+  bytes_pushed_ += len;
+  manage_residency();
+  update_readiness();
 }
 
 void Writer::close()
 {
   close_ = true;
+  update_readiness();
 }
 
 bool Writer::is_closed() const
@@ -42,7 +206,19 @@ uint64_t Writer::bytes_pushed() const
 
 string_view Reader::peek() const
 {
-  return buffer_view_;
+  if ( not adopted_.empty() ) {
+    return string_view( adopted_ ).substr( adopted_.size() - bytes_buffered() );
+  }
+  return buffer_.view( bytes_popped_, bytes_buffered() );
+}
+
+size_t Reader::peek_iov( span<string_view> views ) const
+{
+  if ( views.empty() or bytes_buffered() == 0 ) {
+    return 0;
+  }
+  views[0] = peek(); // buffered bytes are always contiguous (in the ring, or all in the adopted string)
+  return 1;
 }
 
 void Reader::pop( uint64_t len )
@@ -51,21 +227,11 @@ void Reader::pop( uint64_t len )
     return;
   }
   bytes_popped_ += len;
-
-  while ( len > 0 ) {
-    if ( len >= buffer_view_.size() ) {
-      len -= buffer_view_.size();
-      buffer_.pop_front();
-      if ( buffer_.empty() ) {
-        buffer_view_ = string_view();
-        break;
-      }
-      buffer_view_ = buffer_.front();
-    } else {
-      buffer_view_.remove_prefix( len );
-      break;
-    }
+  if ( bytes_buffered() == 0 and not adopted_.empty() ) {
+    pool_.give( exchange( adopted_, {} ) );
   }
+  manage_residency();
+  update_readiness();
 }
 
 bool Reader::is_finished() const
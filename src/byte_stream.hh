@@ -1,8 +1,13 @@
 #pragma once
 
+#include "chunk_pool.hh"
+#include "mirrored_buffer.hh"
+#include "ref.hh"
+
 #include <cstdint>
-#include <deque>
+#include <functional>
 #include <iostream>
+#include <span>
 #include <string>
 #include <string_view>
 
@@ -20,9 +25,31 @@ public:
   Writer& writer();
   const Writer& writer() const;
 
-  void set_error() { error_ = true; };       // Signal that the stream suffered an error.
+  void set_error();                          // Signal that the stream suffered an error.
   bool has_error() const { return error_; }; // Has the stream had an error?
 
+  // Readiness notifications, for event-driven users (e.g. to enable and disable EventLoop rules).
+  //
+  // The reader side is ready while more than `low_watermark` bytes are buffered, or the stream is closed or has
+  // an error. The writer side is ready while fewer than `high_watermark` bytes are buffered and the stream is
+  // still open without an error. Each callback is called with the new state when it is set, and then only
+  // when the state changes (a threshold crossing), not on every push or pop. A copy of the stream has none.
+  void set_reader_watermark( uint64_t low_watermark, std::function<void( bool )> on_change );
+  void set_writer_watermark( uint64_t high_watermark, std::function<void( bool )> on_change );
+
+  // Spare string buffers for whoever fills the stream (e.g. the Reassembler). Owned strings that the stream
+  // has finished with are returned here instead of being freed.
+  ChunkPool& chunk_pool() { return pool_; }
+  const ChunkPool& chunk_pool() const { return pool_; }
+
+  // A stream with at least kSpillCapacity of capacity keeps its ring in an unlinked temporary file (in $TMPDIR,
+  // or else /var/tmp) instead of in memory. Only about kResidentBytes at each end of the buffered bytes (the
+  // reader's head and the writer's tail) stay resident; the middle is written back to the file and read back
+  // in shortly before the reader gets to it, so peek() stays contiguous.
+  static constexpr uint64_t kSpillCapacity = 64 * 1024 * 1024;
+  static constexpr uint64_t kResidentBytes = 4 * 1024 * 1024;
+  bool spills_to_file() const { return buffer_.file_backed(); }
+
 protected:
   // Please add any additional state to the ByteStream here, and not to the Writer and Reader interfaces.
   uint64_t capacity_;
@@ -30,8 +57,41 @@ protected:
   uint64_t bytes_pushed_ {};
   uint64_t bytes_popped_ {};
   bool close_ {};
-  std::deque<std::string> buffer_ {};
-  std::string_view buffer_view_ {};
+  // Ring storage, allocated once. Buffered bytes live at ring positions [bytes_popped_, bytes_pushed_).
+  MirroredBuffer buffer_;
+  // A string pushed into an empty stream is kept as-is instead of being copied into the ring. While it is
+  // non-empty, its tail holds every buffered byte; it is moved into the ring if anything else gets pushed.
+  // (Never used with a file-backed ring, whose bytes have to be in the file to be evicted.)
+  std::string adopted_ {};
+  ChunkPool pool_ {};
+  // A watermark callback and the readiness it was last told about
+  struct Watermark
+  {
+    uint64_t level {};
+    std::function<void( bool )> on_change {};
+    bool ready {};
+
+    // (a copy of the stream doesn't notify the original's observers)
+    Watermark() = default;
+    Watermark( const Watermark& other ) : level( other.level ), on_change(), ready( other.ready ) {}
+    Watermark& operator=( const Watermark& other );
+    Watermark( Watermark&& other ) noexcept = default;
+    Watermark& operator=( Watermark&& other ) noexcept = default;
+    ~Watermark() = default;
+  };
+  Watermark low_watermark_ {};  // reader side
+  Watermark high_watermark_ {}; // writer side
+  // Progress of a file-backed ring's residency hints, as stream offsets
+  uint64_t evicted_to_ {};
+  uint64_t prefetched_to_ {};
+  uint64_t discarded_to_ {};
+  uint64_t written_ahead_to_ {}; // end of the bytes written with Writer::write_ahead(), as a stream offset
+
+  void spill_adopted_to_ring();
+  void manage_residency(); // Keep only the head and tail of a file-backed ring in memory
+  bool reader_is_ready() const;
+  bool writer_is_ready() const;
+  void update_readiness(); // Call the watermark callbacks for any readiness that changed
 };
 
 class Writer : public ByteStream
@@ -40,6 +100,21 @@ public:
   void push( std::string data ); // Push data to stream, but only as much as available capacity allows.
   void close();                  // Signal that the stream has reached its ending. Nothing more will be written.
 
+  // Push an owned string without copying it when the stream is empty (trimming it in place if it exceeds the
+  // available capacity). Borrowed strings, or pushes behind bytes already buffered, are copied into the ring.
+  void push( Ref<std::string> data );
+
+  // Push the bytes of `data` from `offset` on, with the same rules (an owned buffer is kept whole, and its
+  // first `offset` bytes are skipped in place rather than erased).
+  void push( Ref<std::string> data, uint64_t offset );
+
+  // Write `data` into the free space, `offset` bytes past the end of the buffered bytes, without pushing it
+  // (e.g. out-of-order bytes that a Reassembler places directly at their final position). Only what fits within
+  // the available capacity is written. commit( len ) then pushes the first `len` bytes of the free space without
+  // copying them. (A push() would overwrite bytes written ahead, so a writer uses one or the other.)
+  void write_ahead( uint64_t offset, std::string_view data );
+  void commit( uint64_t len );
+
   bool is_closed() const;              // Has the stream been closed?
   uint64_t available_capacity() const; // How many bytes can be pushed to the stream right now?
   uint64_t bytes_pushed() const;       // Total number of bytes cumulatively pushed to the stream
@@ -48,9 +123,13 @@ public:
 class Reader : public ByteStream
 {
 public:
-  std::string_view peek() const; // Peek at the next bytes in the buffer
+  std::string_view peek() const; // Peek at the next bytes in the buffer (all buffered bytes, contiguous)
   void pop( uint64_t len );      // Remove `len` bytes from the buffer
 
+  // Peek at the buffered bytes as a list of views (e.g. for a vectored write). Fills in up to `views.size()`
+  // views, in stream order, and returns how many were used.
+  size_t peek_iov( std::span<std::string_view> views ) const;
+
   bool is_finished() const;        // Is the stream finished (closed and fully popped)?
   uint64_t bytes_buffered() const; // Number of bytes currently buffered (pushed and not popped)
   uint64_t bytes_popped() const;   // Total number of bytes cumulatively popped from stream
@@ -1,7 +1,9 @@
 #include "byte_stream.hh"
 
+#include <algorithm>
 #include <cstdint>
 #include <stdexcept>
+#include <utility>
 
 using namespace std;
 
@@ -12,6 +14,11 @@ using namespace std;
 void read( Reader& reader, uint64_t max_len, string& out )
 {
   out.clear();
+  const uint64_t len = min( max_len, reader.bytes_buffered() );
+  if ( out.capacity() < len ) {
+    // (Trade `out` for a buffer with room from the stream's pool, rather than growing it)
+    reader.chunk_pool().give( exchange( out, reader.chunk_pool().take( len ) ) );
+  }
 
   while ( reader.bytes_buffered() and out.size() < max_len ) {
     auto view = reader.peek();
@@ -0,0 +1,108 @@
+#include "congestion_control.hh"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+CongestionControl::CongestionControl( uint64_t mss )
+  : mss_( mss ), cwnd_( min( 4 * mss, max<uint64_t>( 2 * mss, 4380 ) ) ) // initial window (RFC 3390)
+{}
+
+unique_ptr<CongestionControl> CongestionControl::make( TCPConfig::Congestion algorithm, uint64_t mss )
+{
+  switch ( algorithm ) {
+    case TCPConfig::Congestion::NewReno:
+      return make_unique<NewReno>( mss );
+    case TCPConfig::Congestion::Cubic:
+      return make_unique<Cubic>( mss );
+    case TCPConfig::Congestion::None:
+      break;
+  }
+  return nullptr;
+}
+
+void CongestionControl::on_ack( uint64_t bytes_acked, uint64_t now_ms, uint64_t RTT_ms )
+{
+  if ( cwnd_ < ssthresh_ ) {
+    cwnd_ += min( bytes_acked, mss_ ); // slow start
+  } else {
+    avoid_congestion( bytes_acked, now_ms, RTT_ms );
+  }
+}
+
+void CongestionControl::on_rto( uint64_t bytes_in_flight, uint64_t /* now_ms */ )
+{
+  ssthresh_ = max( bytes_in_flight / 2, 2 * mss_ );
+  cwnd_ = mss_;
+}
+
+void NewReno::on_loss( uint64_t bytes_in_flight, uint64_t /* now_ms */ )
+{
+  ssthresh_ = max( bytes_in_flight / 2, 2 * mss_ );
+  cwnd_ = ssthresh_;
+  bytes_acked_ = 0;
+}
+
+void NewReno::avoid_congestion( uint64_t bytes_acked, uint64_t /* now_ms */, uint64_t /* RTT_ms */ )
+{
+  bytes_acked_ += bytes_acked;
+  if ( bytes_acked_ >= cwnd_ ) {
+    bytes_acked_ -= cwnd_;
+    cwnd_ += mss_;
+  }
+}
+
+void Cubic::reduce( uint64_t /* now_ms */ )
+{
+  const double cwnd = static_cast<double>( cwnd_ ) / static_cast<double>( mss_ );
+  W_max_ = cwnd < W_max_ ? cwnd * ( 1 + beta ) / 2 : cwnd; // fast convergence: yield to newer flows
+  ssthresh_ = max( static_cast<uint64_t>( cwnd * beta * static_cast<double>( mss_ ) ), 2 * mss_ );
+  epoch_started_ = false;
+}
+
+void Cubic::on_loss( uint64_t /* bytes_in_flight */, uint64_t now_ms )
+{
+  reduce( now_ms );
+  cwnd_ = ssthresh_;
+}
+
+void Cubic::on_rto( uint64_t /* bytes_in_flight */, uint64_t now_ms )
+{
+  reduce( now_ms );
+  cwnd_ = mss_;
+}
+
+void Cubic::avoid_congestion( uint64_t bytes_acked, uint64_t now_ms, uint64_t RTT_ms )
+{
+  const auto mss = static_cast<double>( mss_ );
+  if ( not epoch_started_ ) {
+    epoch_started_ = true;
+    epoch_start_ms_ = now_ms;
+    cwnd_segments_ = static_cast<double>( cwnd_ ) / mss;
+    if ( cwnd_segments_ >= W_max_ ) {
+      W_max_ = cwnd_segments_;
+      K_ = 0;
+    } else {
+      K_ = cbrt( ( W_max_ - cwnd_segments_ ) / C );
+    }
+    W_est_ = cwnd_segments_;
+  }
+
+  const auto W_cubic = [&]( double t ) { return C * pow( t - K_, 3 ) + W_max_; };
+  const double t = static_cast<double>( now_ms - epoch_start_ms_ ) / 1000;
+  const double segments_acked = static_cast<double>( bytes_acked ) / mss;
+
+  // The window NewReno would have by now (growing faster once past W_max)
+  const double alpha = W_est_ >= W_max_ ? 1 : 3 * ( 1 - beta ) / ( 1 + beta );
+  W_est_ += alpha * segments_acked / cwnd_segments_;
+
+  if ( W_cubic( t ) < W_est_ ) {
+    cwnd_segments_ = W_est_;
+  } else {
+    const double target = clamp( W_cubic( t + static_cast<double>( RTT_ms ) / 1000 ), cwnd_segments_,
+                                 1.5 * cwnd_segments_ );
+    cwnd_segments_ += ( target - cwnd_segments_ ) / cwnd_segments_ * segments_acked;
+  }
+  cwnd_ = max( mss_, static_cast<uint64_t>( cwnd_segments_ * mss ) );
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "tcp_config.hh"
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+// A CongestionControl decides how many bytes a TCPSender may have in flight (the congestion window, cwnd), from
+// what the sender tells it about acknowledgments and losses. The sender sends no more than min(cwnd, rwnd).
+// All sizes are in bytes (sequence numbers), and times in milliseconds of the sender's clock.
+class CongestionControl
+{
+public:
+  explicit CongestionControl( uint64_t mss );
+  virtual ~CongestionControl() = default;
+
+  // New bytes were acknowledged. `RTT_ms` is the sender's smoothed round-trip time (zero before the first sample).
+  virtual void on_ack( uint64_t bytes_acked, uint64_t now_ms, uint64_t RTT_ms );
+
+  // A loss was detected while the ACK clock keeps running (e.g. by duplicate ACKs): halve, or so, the window.
+  virtual void on_loss( uint64_t bytes_in_flight, uint64_t now_ms ) = 0;
+
+  // The retransmission timer expired (the first time for this segment): start over from one segment.
+  virtual void on_rto( uint64_t bytes_in_flight, uint64_t now_ms );
+
+  uint64_t cwnd() const { return cwnd_; }
+  uint64_t ssthresh() const { return ssthresh_; }
+  uint64_t mss() const { return mss_; }
+
+  // The algorithm TCPConfig selects, or nullptr for none
+  static std::unique_ptr<CongestionControl> make( TCPConfig::Congestion algorithm, uint64_t mss );
+
+protected:
+  // Grow the window during congestion avoidance (cwnd >= ssthresh), for `bytes_acked` more bytes.
+  virtual void avoid_congestion( uint64_t bytes_acked, uint64_t now_ms, uint64_t RTT_ms ) = 0;
+
+  uint64_t mss_;
+  uint64_t cwnd_;
+  uint64_t ssthresh_ { std::numeric_limits<uint64_t>::max() };
+};
+
+// RFC 5681: slow start, then one more segment per window acknowledged; half the flight on a loss
+class NewReno : public CongestionControl
+{
+public:
+  using CongestionControl::CongestionControl;
+
+  void on_loss( uint64_t bytes_in_flight, uint64_t now_ms ) override;
+
+protected:
+  void avoid_congestion( uint64_t bytes_acked, uint64_t now_ms, uint64_t RTT_ms ) override;
+
+private:
+  uint64_t bytes_acked_ {}; // toward the next increase
+};
+
+// RFC 9438: after a loss, the window grows along a cubic function of the time since, flattening out around the
+// window where the loss happened (and never more slowly than NewReno would)
+class Cubic : public CongestionControl
+{
+public:
+  using CongestionControl::CongestionControl;
+
+  void on_loss( uint64_t bytes_in_flight, uint64_t now_ms ) override;
+  void on_rto( uint64_t bytes_in_flight, uint64_t now_ms ) override;
+
+  static constexpr double C = 0.4;
+  static constexpr double beta = 0.7;
+
+protected:
+  void avoid_congestion( uint64_t bytes_acked, uint64_t now_ms, uint64_t RTT_ms ) override;
+
+private:
+  void reduce( uint64_t now_ms );
+
+  // Windows in segments (W_max is the window at the last loss, before reduction)
+  double W_max_ {};
+  double W_est_ {};        // the NewReno-friendly estimate
+  double K_ {};            // seconds from the start of the epoch until the cubic returns to W_max
+  bool epoch_started_ {};  // (reset by losses; the first ACK of congestion avoidance starts an epoch)
+  uint64_t epoch_start_ms_ {};
+  double cwnd_segments_ {}; // cwnd, with fractions of a segment
+};
@@ -1,128 +1,365 @@
 #include "reassembler.hh"
 #include "debug.hh"
 
+#include <algorithm>
+#include <bit>
+
 using namespace std;
 
-void Reassembler::write_to_output( string& data, Writer& writer )
+namespace {
+// A stored fragment's share of Reassembler::count_overhead_bytes()
+uint64_t overhead( const Reassembler::Slice& fragment )
+{
+  return Reassembler::kFragmentOverhead + fragment.buffer.capacity() - fragment.size();
+}
+} // namespace
+
+Reassembler::Reassembler( ByteStream&& output, Engine engine ) : Reassembler( std::move( output ), engine, {} ) {}
+
+Reassembler::Reassembler( ByteStream&& output, Engine engine, Limits limits )
+  : output_( std::move( output ) )
+  , engine_( engine )
+  , limits_( limits )
+  , present_( engine == Engine::Bitmap
+                ? output_.writer().available_capacity() + output_.reader().bytes_buffered()
+                : 0 )
+{}
+
+void Reassembler::write_to_output( string& data, uint64_t offset )
 {
-  next_index_ += data.size();
-  writer.push( move( data ) );
+  next_index_ += data.size() - offset;
+  output_.writer().push( Ref<string> { move( data ) }, offset );
 }
 
-bool Reassembler::cantain_next_index( uint64_t first_index, uint64_t data_len )
+void Reassembler::append( string& head, string_view tail )
 {
-  if ( data_len == 0 ) {
-    return first_index == next_index_;
+  const size_t needed = head.size() + tail.size();
+  if ( head.capacity() < needed ) {
+    // Move into a big enough buffer from the output stream's pool (rather than letting the string reallocate)
+    string joined = output_.chunk_pool().take( max( needed, 2 * head.capacity() ) );
+    joined.append( head );
+    output_.chunk_pool().give( move( head ) );
+    head = move( joined );
+  }
+  head.append( tail );
+}
+
+void Reassembler::store( uint64_t first_index, string& data, uint64_t offset )
+{
+  ChunkPool& pool = output_.chunk_pool();
+  const uint64_t end_index = first_index + data.size() - offset;
+  if ( end_index == first_index ) {
+    return;
+  }
+
+  // The fragment that starts at or before `first_index` might already hold all of the new bytes, or the
+  // first few of them
+  auto it = pending_.upper_bound( first_index );
+  const auto before = it == pending_.begin() ? pending_.end() : prev( it );
+  if ( before != pending_.end() ) {
+    const uint64_t before_end = before->first + before->second.size();
+    if ( before_end >= end_index ) {
+      stats_.duplicate_bytes += end_index - first_index;
+      pool.give( move( data ) );
+      return;
+    }
+    if ( before_end > first_index ) {
+      stats_.duplicate_bytes += before_end - first_index;
+      offset += before_end - first_index;
+      first_index = before_end;
+    }
+  }
+
+  // Fragments that lie within the new bytes are superseded by them
+  while ( it != pending_.end() and it->first + it->second.size() <= end_index ) {
+    bytes_pending_ -= it->second.size();
+    overhead_bytes_ -= overhead( it->second );
+    stats_.duplicate_bytes += it->second.size();
+    count_holes( it, false );
+    pool.give( move( it->second.buffer ) );
+    it = pending_.erase( it );
+  }
+
+  // A fragment that straddles the end of the new bytes keeps its bytes, and the new ones give up their tail
+  if ( it != pending_.end() and it->first < end_index ) {
+    stats_.duplicate_bytes += end_index - it->first;
+    data.resize( data.size() - ( end_index - it->first ) );
+  }
+
+  const uint64_t len = data.size() - offset;
+  bytes_pending_ += len;
+  if ( before != pending_.end() and before->first + before->second.size() == first_index
+       and len <= kCoalesceBytes ) {
+    // A few bytes right after the fragment before: cheaper to copy them onto it than to store another slice
+    overhead_bytes_ -= overhead( before->second );
+    count_holes( before, false );
+    append( before->second.buffer, string_view( data ).substr( offset ) );
+    count_holes( before, true );
+    overhead_bytes_ += overhead( before->second );
+    pool.give( move( data ) );
+  } else {
+    Slice slice { move( data ), offset };
+    overhead_bytes_ += overhead( slice );
+    count_holes( pending_.emplace_hint( it, first_index, move( slice ) ), true );
   }
-  return first_index <= next_index_ && first_index + data_len > next_index_;
 }
 
-void Reassembler::pop_from_reassemble_buffer()
+void Reassembler::enforce_limits()
 {
-  auto [buffer_first_index, buffer_data_len, buffer_data] = reassember_buffer_.front();
+  const auto over = [&] {
+    return pending_.size() > limits_.max_fragments or overhead_bytes_ > limits_.max_overhead_bytes;
+  };
+  if ( not over() ) {
+    return;
+  }
 
-  reassember_buffer_.pop_front();
+  Evictions& evictions = stats_.evictions;
+  ++evictions.triggered;
+  while ( not pending_.empty() and over() ) {
+    auto furthest = prev( pending_.end() );
+    ++evictions.fragments;
+    evictions.bytes += furthest->second.size();
+    bytes_pending_ -= furthest->second.size();
+    overhead_bytes_ -= overhead( furthest->second );
+    count_holes( furthest, false );
+    output_.chunk_pool().give( move( furthest->second.buffer ) );
+    pending_.erase( furthest );
+  }
+}
 
-  write_to_output( buffer_data, output_.writer() );
+void Reassembler::flush_contiguous()
+{
+  while ( not pending_.empty() and pending_.begin()->first == next_index_ ) {
+    count_holes( pending_.begin(), false );
+    Slice slice = move( pending_.begin()->second );
+    pending_.erase( pending_.begin() );
+    bytes_pending_ -= slice.size();
+    overhead_bytes_ -= overhead( slice );
+    write_to_output( slice.buffer, slice.offset );
+  }
 
-  if ( had_last_ && reassember_buffer_.empty() ) {
+  if ( had_last_ and next_index_ >= end_index_ ) {
     output_.writer().close();
   }
 }
 
-void Reassembler::insert_and_merge( uint64_t first_index, string& data )
+void Reassembler::count_holes( map<uint64_t, Slice>::const_iterator it, bool stored )
 {
-  auto it = reassember_buffer_.begin();
-  while ( it != reassember_buffer_.end() ) {
-    uint64_t buffer_first_index = get<0>( *it );
-    uint64_t buffer_data_len = get<1>( *it );
-    string buffer_data = get<2>( *it );
+  const auto end_of = []( const auto& fragment ) { return fragment.first + fragment.second.size(); };
+  const uint64_t touching = ( it != pending_.begin() and end_of( *prev( it ) ) == it->first )
+                            + ( next( it ) != pending_.end() and end_of( *it ) == next( it )->first );
+  stats_.holes = stored ? stats_.holes + 1 - touching : stats_.holes + touching - 1;
+}
 
-    if ( first_index + data.size() < buffer_first_index ) {
-      reassember_buffer_.insert( it, make_tuple( first_index, data.size(), data ) );
-      return;
-    }
-    // data与buffer_data正好可以合并
-    else if ( first_index + data.size() == buffer_first_index ) {
-      string new_data = data + buffer_data;
-      it = reassember_buffer_.erase( it );
-      insert_and_merge( first_index, new_data );
-      return;
-    }
-    // data与buffer_data有重叠且data在buffer_data之前
-    else if ( first_index < buffer_first_index ) {
-      // data后半部分无突出
-      if ( first_index + data.size() < buffer_first_index + buffer_data_len ) {
-        string new_data = data.substr( 0, buffer_first_index - first_index );
-        new_data = new_data + buffer_data;
-        it = reassember_buffer_.erase( it );
-        reassember_buffer_.insert( it, make_tuple( first_index, new_data.size(), new_data ) );
-        return;
-      }
-      // data包含buffer_data
-      else {
-        it = reassember_buffer_.erase( it );
-        continue;
-      }
-    }
-    // buffer_data包含data的前半部分
-    else if ( first_index <= buffer_first_index + buffer_data_len ) {
-      if ( first_index + data.size() > buffer_first_index + buffer_data_len ) {
-        string new_data = data.substr( buffer_first_index + buffer_data_len - first_index );
-        new_data = buffer_data + new_data;
-        it = reassember_buffer_.erase( it );
-        insert_and_merge( buffer_first_index, new_data );
-      }
-      return;
-    } else {
-      it++;
-    }
+void Reassembler::write_in_place( uint64_t first_index, string_view data )
+{
+  if ( data.empty() ) {
+    return;
   }
-  reassember_buffer_.push_back( make_tuple( first_index, data.size(), data ) );
+  output_.writer().write_ahead( first_index - next_index_, data );
+
+  // The runs of stored bytes that the new ones overlap or touch become one
+  const uint64_t begin = first_index - ( first_index > next_index_ );
+  const uint64_t end = min( first_index + data.size() + 1, next_index_ + present_.size() );
+  stats_.holes = stats_.holes + 1 - present_.count_runs( begin, end - begin );
+
+  const uint64_t added = present_.set( first_index, data.size() );
+  stats_.duplicate_bytes += data.size() - added;
+  bytes_pending_ += added;
 }
 
-void Reassembler::insert( uint64_t first_index, string data, bool is_last_substring )
+void Reassembler::commit_in_place()
 {
+  Writer& writer = output_.writer();
+  const uint64_t ready = present_.run_length( next_index_, bytes_pending_ );
+  if ( ready > 0 ) {
+    --stats_.holes; // (the bytes committed are the whole run at next_index_)
+    present_.clear( next_index_, ready );
+    bytes_pending_ -= ready;
+    next_index_ += ready;
+    writer.commit( ready );
+  }
+
+  if ( had_last_ and next_index_ >= end_index_ ) {
+    writer.close();
+  }
+}
 
+optional<uint64_t> Reassembler::accept( uint64_t first_index, string& data, bool is_last_substring )
+{
   uint64_t data_len = data.size();
   auto end_index = first_index + data_len;
   auto last_index = next_index_ + output_.writer().available_capacity();
 
+  if ( first_index >= next_index_ ) {
+    ++stats_.reorder_distance[min( static_cast<size_t>( bit_width( first_index - next_index_ ) ),
+                                   Stats::kReorderBuckets - 1 )];
+  }
+
   if ( ( data_len > 0 && end_index <= next_index_ ) || ( data_len == 0 && end_index < next_index_ )
        || first_index >= last_index ) {
-    return;
+    stats_.duplicate_bytes += end_index <= next_index_ ? data_len : 0;
+    return nullopt;
   }
 
   if ( is_last_substring ) {
     had_last_ = true;
+    end_index_ = end_index;
   }
 
   if ( first_index + data_len > last_index ) {
-    data = data.substr( 0, last_index - first_index );
+    data.resize( last_index - first_index );
     had_last_ = false;
   }
 
-  if ( first_index < next_index_ ) {
-    data = data.substr( next_index_ - first_index );
-    first_index = next_index_;
+  const uint64_t written = next_index_ - min( first_index, next_index_ );
+  stats_.duplicate_bytes += written;
+  return written;
+}
+
+void Reassembler::insert( uint64_t first_index, string data, bool is_last_substring )
+{
+  Segment segment { first_index, move( data ), is_last_substring };
+  insert_many( span { &segment, 1 } );
+}
+
+void Reassembler::insert_many( span<Segment> segments )
+{
+  ranges::sort( segments, {}, &Segment::first_index );
+
+  for ( auto& [first_index, data, is_last_substring] : segments ) {
+    if ( const auto written = accept( first_index, data, is_last_substring ) ) {
+      const uint64_t index = first_index + *written;
+
+      if ( engine_ == Engine::Bitmap ) {
+        write_in_place( index, string_view( data ).substr( *written ) );
+      } else if ( index == next_index_
+                  and ( pending_.empty() or first_index + data.size() <= pending_.begin()->first ) ) {
+        // In order, and nothing stored that it overlaps: skip the map.
+        write_to_output( data, *written );
+      } else {
+        store( index, data, *written );
+        enforce_limits();
+      }
+    }
+
+    // (A buffer still here -- nothing in it was new, or its bytes were copied in place -- goes to the pool.)
+    output_.chunk_pool().give( move( data ) );
+  }
+
+  if ( engine_ == Engine::Bitmap ) {
+    commit_in_place();
+  } else {
+    flush_contiguous();
+  }
+  stats_.peak_bytes_pending = max( stats_.peak_bytes_pending, bytes_pending_ );
+}
+
+vector<Reassembler::Interval> Reassembler::stored_intervals() const
+{
+  vector<Interval> ret;
+  if ( engine_ == Engine::Bitmap ) {
+    const uint64_t window_end = next_index_ + present_.size();
+    for ( uint64_t index = next_index_; index < window_end; ) {
+      index += present_.gap_length( index, window_end - index );
+      const uint64_t run = present_.run_length( index, window_end - index );
+      if ( run > 0 ) {
+        ret.push_back( { index, index + run } );
+      }
+      index += run;
+    }
+  } else {
+    for ( const auto& [index, slice] : pending_ ) {
+      if ( not ret.empty() and ret.back().end == index ) {
+        ret.back().end += slice.size();
+      } else {
+        ret.push_back( { index, index + slice.size() } );
+      }
+    }
   }
+  return ret;
+}
 
-  data_len = data.size();
+optional<Reassembler::Interval> Reassembler::interval_holding( uint64_t index ) const
+{
+  if ( engine_ == Engine::Bitmap ) {
+    const uint64_t window_end = next_index_ + present_.size();
+    if ( index < next_index_ or index >= window_end or present_.run_length( index, 1 ) == 0 ) {
+      return nullopt;
+    }
+    return Interval { index - present_.run_length_before( index, index - next_index_ ),
+                      index + present_.run_length( index, window_end - index ) };
+  }
 
-  insert_and_merge( first_index, data );
+  const auto end_of = []( const auto& fragment ) { return fragment.first + fragment.second.size(); };
+  auto next = pending_.upper_bound( index );
+  if ( next == pending_.begin() or index >= end_of( *prev( next ) ) ) {
+    return nullopt;
+  }
 
-  if ( cantain_next_index( first_index, data_len ) ) {
-    pop_from_reassemble_buffer();
+  // (Stored fragments may abut: the interval takes in its neighbours on both sides.)
+  auto first = prev( next );
+  while ( first != pending_.begin() and end_of( *prev( first ) ) == first->first ) {
+    --first;
+  }
+  uint64_t end = end_of( *prev( next ) );
+  for ( ; next != pending_.end() and next->first == end; ++next ) {
+    end += next->second.size();
   }
+  return Interval { first->first, end };
 }
 
-// How many bytes are stored in the Reassembler itself?
-// This function is for testing only; don't add extra state to support it.
-uint64_t Reassembler::count_bytes_pending() const
+size_t Reassembler::stored_intervals( span<Interval> out, uint64_t index ) const
 {
-  uint64_t buffer_size_ = 0;
-  for ( auto& [first_index, data_len, data] : reassember_buffer_ ) {
-    buffer_size_ += data_len;
+  const auto holding = interval_holding( index );
+  size_t count = 0;
+  if ( holding.has_value() and not out.empty() ) {
+    out[count++] = *holding;
+  }
+
+  // (Returns false once `out` is full.)
+  const auto add = [&]( const Interval& interval ) {
+    if ( count < out.size() and not( holding.has_value() and interval.begin == holding->begin ) ) {
+      out[count++] = interval;
+    }
+    return count < out.size();
+  };
+
+  if ( count == out.size() ) {
+    return count;
+  }
+  if ( engine_ == Engine::Bitmap ) {
+    const uint64_t window_end = next_index_ + present_.size();
+    for ( uint64_t i = next_index_; i < window_end; ) {
+      i += present_.gap_length( i, window_end - i );
+      const uint64_t run = present_.run_length( i, window_end - i );
+      if ( run > 0 and not add( { i, i + run } ) ) {
+        break;
+      }
+      i += run;
+    }
+  } else {
+    optional<Interval> current;
+    for ( const auto& [i, slice] : pending_ ) {
+      if ( current.has_value() and current->end == i ) {
+        current->end += slice.size();
+        continue;
+      }
+      if ( current.has_value() and not add( *current ) ) {
+        return count;
+      }
+      current = Interval { i, i + slice.size() };
+    }
+    if ( current.has_value() ) {
+      add( *current );
+    }
   }
-  return buffer_size_;
+  return count;
+}
+
+Reassembler::Stats Reassembler::stats() const
+{
+  Stats ret = stats_;
+  ret.bytes_pending = bytes_pending_;
+  return ret;
 }
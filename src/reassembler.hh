@@ -1,14 +1,80 @@
 #pragma once
 
 #include "byte_stream.hh"
-#include <list>
-#include <tuple>
+#include "ring_bitmap.hh"
+
+#include <array>
+#include <limits>
+#include <map>
+#include <optional>
+#include <span>
+#include <vector>
 
 class Reassembler
 {
 public:
+  // How out-of-order bytes are held until the bytes before them arrive
+  enum class Engine
+  {
+    Fragments, // as slices of the received payloads, in an ordered map (memory in proportion to the bytes held)
+    Bitmap,    // in place, in the output stream's own free space, with a bitmap of the bytes that are present
+  };
+
+  // Caps on what the fragment engine holds out of order. Past either one, the fragments furthest from the
+  // output are dropped (they are the last ones needed, and the sender will retransmit them). The bitmap engine
+  // ignores these: its memory is fixed by the capacity.
+  struct Limits
+  {
+    size_t max_fragments = std::numeric_limits<size_t>::max();
+    uint64_t max_overhead_bytes = std::numeric_limits<uint64_t>::max(); // see count_overhead_bytes()
+  };
+
+  // How often the Limits have been enforced
+  struct Evictions
+  {
+    uint64_t triggered {}; // insertions that left the Reassembler over a limit
+    uint64_t fragments {}; // fragments dropped
+    uint64_t bytes {};     // bytes dropped (the sender has to send them again)
+  };
+
+  // A stored fragment: the bytes of a received payload from `offset` on (trimming the front of a payload is
+  // just a larger offset, and its end is trimmed in place)
+  struct Slice
+  {
+    std::string buffer {};
+    uint64_t offset {};
+
+    uint64_t size() const { return buffer.size() - offset; }
+    std::string_view view() const { return std::string_view { buffer }.substr( offset ); }
+  };
+
+  // What the Reassembler has seen, for telling why a connection stalls. Kept up to date with a few increments
+  // per insertion (and per fragment stored or dropped), so stats() is O(1).
+  struct Stats
+  {
+    // Segments are counted in reorder_distance[ bit_width( first_index - next index ) ] (so [0] is segments
+    // in order, [1] is 1 byte ahead, [2] 2-3 bytes, [3] 4-7 bytes, ... and the last bucket also takes any
+    // further). Segments that begin before the next index aren't counted (they are retransmissions).
+    static constexpr size_t kReorderBuckets = 33;
+
+    uint64_t holes {};              // gaps between the bytes written and the bytes stored, or between stored bytes
+    uint64_t bytes_pending {};      // count_bytes_pending()
+    uint64_t peak_bytes_pending {}; // the most count_bytes_pending() has been after an insertion
+    uint64_t duplicate_bytes {};    // bytes discarded because they had already been written or stored
+    std::array<uint64_t, kReorderBuckets> reorder_distance {};
+    Evictions evictions {};
+  };
+
+  // Estimated cost of a stored fragment beyond its bytes: the map node, including the Slice itself
+  static constexpr uint64_t kFragmentOverhead = 4 * sizeof( void* ) + sizeof( std::pair<const uint64_t, Slice> );
+
+  // A fragment that touches the end of the one before it is copied onto it if it is at most this long (a
+  // node costs more than copying a few bytes); longer ones are kept as separate slices of their own payloads.
+  static constexpr uint64_t kCoalesceBytes = 256;
+
   // Construct Reassembler to write into given ByteStream.
-  explicit Reassembler( ByteStream&& output ) : output_( std::move( output ) ) {}
+  explicit Reassembler( ByteStream&& output, Engine engine = Engine::Fragments );
+  Reassembler( ByteStream&& output, Engine engine, Limits limits );
 
   /*
    * Insert a new substring to be reassembled into a ByteStream.
@@ -32,9 +98,43 @@ public:
    */
   void insert( uint64_t first_index, std::string data, bool is_last_substring );
 
+  // A substring, for insert_many()
+  struct Segment
+  {
+    uint64_t first_index {};
+    std::string data {};
+    bool is_last_substring {};
+  };
+
+  // Insert a batch of substrings (e.g. a burst of segments that arrived together), with the same result as
+  // inserting them one at a time. The batch is sorted in place by index and merged against the stored bytes
+  // in that order. With the bitmap engine, whatever becomes contiguous is committed to the output at once;
+  // the fragment engine writes in-order segments as it goes (joining them first would cost a copy).
+  void insert_many( std::span<Segment> segments );
+
   // How many bytes are stored in the Reassembler itself?
-  // This function is for testing only; don't add extra state to support it.
-  uint64_t count_bytes_pending() const;
+  uint64_t count_bytes_pending() const { return bytes_pending_; }
+
+  // How many fragments are stored, and the memory they take beyond the bytes themselves (kFragmentOverhead
+  // each, plus the unused and skipped parts of their buffers)? Both are zero with the bitmap engine.
+  size_t count_fragments() const { return pending_.size(); }
+  uint64_t count_overhead_bytes() const { return overhead_bytes_; }
+
+  const Evictions& evictions() const { return stats_.evictions; }
+
+  Stats stats() const;
+
+  // The stored bytes, as maximal ranges of stream indices [begin, end), in order (e.g. for SACK blocks)
+  struct Interval
+  {
+    uint64_t begin {};
+    uint64_t end {};
+  };
+  std::vector<Interval> stored_intervals() const;
+
+  // The same, but at most out.size() of them, written to `out` without allocating: the one holding the byte at
+  // `index` first (if it is stored), then the others in order, as far as they fit. Returns how many it wrote.
+  size_t stored_intervals( std::span<Interval> out, uint64_t index ) const;
 
   // Access output stream reader
   Reader& reader() { return output_.reader(); }
@@ -44,18 +144,53 @@ public:
   const Writer& writer() const { return output_.writer(); }
 
 protected:
-  void write_to_output( std::string& data, Writer& writer );
+  // Push the bytes of `data` from `offset` on, handing over the buffer itself.
+  void write_to_output( std::string& data, uint64_t offset );
+
+  // Drop whatever the bytes of `data` from `offset` on (at `first_index`) have in common with the stored
+  // fragments, then store what remains (without copying the bytes, unless they are few; see kCoalesceBytes).
+  void store( uint64_t first_index, std::string& data, uint64_t offset );
+
+  // Write the stored fragments that have become contiguous with the output.
+  void flush_contiguous();
+
+  // Drop the furthest-out fragments until the stored ones are within the limits.
+  void enforce_limits();
+
+  // Bitmap engine: write `data` (at `first_index`) to its final position, and mark it present.
+  void write_in_place( uint64_t first_index, std::string_view data );
+
+  // Bitmap engine: commit the bytes that have become contiguous with the output.
+  void commit_in_place();
+
+  // Apply the window to a substring (trimming the end of `data` as needed, and noting the end of the stream
+  // and the substring's reorder distance and duplicate bytes).
+  // Returns how many bytes at its start were already written, or nothing if nothing is left to insert.
+  std::optional<uint64_t> accept( uint64_t first_index, std::string& data, bool is_last_substring );
 
-  bool cantain_next_index( uint64_t first_index, uint64_t data_len );
+  // The maximal range of stored bytes that holds the byte at `index`, if it is stored.
+  std::optional<Interval> interval_holding( uint64_t index ) const;
 
-  void pop_from_reassemble_buffer();
+  // Append `tail` to a fragment, growing it with a buffer from the output stream's chunk pool if needed.
+  void append( std::string& head, std::string_view tail );
 
-  void insert_and_merge( uint64_t first_index, std::string& data );
+  // Fragment engine: count the holes that the fragment at `it` makes (`stored`) or closes (not `stored`): one,
+  // less one for each neighbour that it touches. Called after a fragment is stored, and before one is dropped.
+  void count_holes( std::map<uint64_t, Slice>::const_iterator it, bool stored );
 
 private:
   ByteStream output_;
+  Engine engine_;
   bool had_last_ {};
+  uint64_t end_index_ {}; // (once had_last_ is set)
   uint64_t next_index_ {};
-  // tuple<first_index, data_len, data>
-  std::list<std::tuple<uint64_t, uint64_t, std::string>> reassember_buffer_ {};
+  // Out-of-order fragments, keyed by the index of their first byte. They never overlap, and they are all
+  // after next_index_.
+  std::map<uint64_t, Slice> pending_ {};
+  uint64_t bytes_pending_ {};
+  uint64_t overhead_bytes_ {};
+  Limits limits_;
+  Stats stats_ {}; // (except bytes_pending, which stats() fills in)
+  // Bitmap engine: which bytes of the window (by stream index) have been written ahead into the output stream
+  RingBitmap present_;
 };
@@ -0,0 +1,202 @@
+#include "spsc_byte_stream.hh"
+
+#include <algorithm>
+
+using namespace std;
+
+// The producer publishes bytes with a release store to bytes_pushed_, and the consumer frees space with a
+// release store to bytes_popped_; each side reads the other's counter with an acquire load.
+//
+// Wakeups: when events are enabled, each side follows its counter store with a seq_cst fence before looking
+// at the other side's counter to decide whether to signal. The other side does the same (fence, then load)
+// before resetting its event, so at least one of the two always sees the other's update, and a wakeup can't
+// be lost between "the stream looked empty (or full)" and "go to sleep".
+
+SPSCByteStream::SPSCByteStream( uint64_t capacity, bool with_events ) : capacity_( capacity ), buffer_( capacity )
+{
+  if ( with_events ) {
+    readable_.emplace();
+    writable_.emplace();
+    if ( capacity_ > 0 ) {
+      writable_->notify();
+    }
+  }
+}
+
+void SPSCByteStream::set_error()
+{
+  error_.store( true, memory_order_release );
+  if ( readable_ ) {
+    readable_->notify();
+    writable_->notify();
+  }
+}
+
+bool SPSCByteStream::has_error() const
+{
+  return error_.load( memory_order_acquire );
+}
+
+uint64_t SPSCWriter::push( string_view data )
+{
+  if ( is_closed() or data.empty() ) {
+    return 0;
+  }
+
+  const uint64_t pushed = bytes_pushed_.load( memory_order_relaxed );
+  uint64_t space = capacity_ - ( pushed - producer_popped_cache_ );
+  if ( data.size() > space ) {
+    producer_popped_cache_ = bytes_popped_.load( memory_order_acquire );
+    space = capacity_ - ( pushed - producer_popped_cache_ );
+  }
+
+  const uint64_t write_size = min( space, static_cast<uint64_t>( data.size() ) );
+  if ( write_size == 0 ) {
+    return 0;
+  }
+
+  buffer_.write( pushed, data.substr( 0, write_size ) );
+  bytes_pushed_.store( pushed + write_size, memory_order_release );
+
+  if ( readable_ ) {
+    atomic_thread_fence( memory_order_seq_cst );
+    if ( bytes_popped_.load( memory_order_relaxed ) == pushed ) {
+      readable_->notify(); // the consumer had drained the stream, and may be waiting
+    }
+  }
+
+  return write_size;
+}
+
+void SPSCWriter::close()
+{
+  closed_.store( true, memory_order_release );
+  if ( readable_ ) {
+    readable_->notify();
+  }
+}
+
+bool SPSCWriter::is_closed() const
+{
+  return closed_.load( memory_order_acquire );
+}
+
+uint64_t SPSCWriter::available_capacity() const
+{
+  producer_popped_cache_ = bytes_popped_.load( memory_order_acquire );
+  return capacity_ - ( bytes_pushed_.load( memory_order_relaxed ) - producer_popped_cache_ );
+}
+
+uint64_t SPSCWriter::bytes_pushed() const
+{
+  return bytes_pushed_.load( memory_order_relaxed );
+}
+
+FileDescriptor& SPSCWriter::writable_event()
+{
+  return writable_.value();
+}
+
+void SPSCWriter::acknowledge_event()
+{
+  if ( not writable_ or available_capacity() > 0 or has_error() ) {
+    return;
+  }
+  writable_->clear();
+  atomic_thread_fence( memory_order_seq_cst );
+  if ( available_capacity() > 0 or has_error() ) {
+    writable_->notify(); // raced with a pop
+  }
+}
+
+string_view SPSCReader::peek() const
+{
+  const uint64_t popped = bytes_popped_.load( memory_order_relaxed );
+  if ( consumer_pushed_cache_ == popped ) {
+    consumer_pushed_cache_ = bytes_pushed_.load( memory_order_acquire );
+  }
+  return buffer_.view( popped, consumer_pushed_cache_ - popped );
+}
+
+void SPSCReader::pop( uint64_t len )
+{
+  if ( len == 0 or len > bytes_buffered() ) {
+    return;
+  }
+
+  const uint64_t popped = bytes_popped_.load( memory_order_relaxed );
+  bytes_popped_.store( popped + len, memory_order_release );
+
+  if ( writable_ ) {
+    atomic_thread_fence( memory_order_seq_cst );
+    if ( bytes_pushed_.load( memory_order_relaxed ) - popped >= capacity_ ) {
+      writable_->notify(); // the stream was full, and the producer may be waiting
+    }
+  }
+}
+
+bool SPSCReader::is_finished() const
+{
+  const bool closed = closed_.load( memory_order_acquire ); // (before reading bytes_pushed_)
+  return closed and bytes_buffered() == 0;
+}
+
+uint64_t SPSCReader::bytes_buffered() const
+{
+  consumer_pushed_cache_ = bytes_pushed_.load( memory_order_acquire );
+  return consumer_pushed_cache_ - bytes_popped_.load( memory_order_relaxed );
+}
+
+uint64_t SPSCReader::bytes_popped() const
+{
+  return bytes_popped_.load( memory_order_relaxed );
+}
+
+FileDescriptor& SPSCReader::readable_event()
+{
+  return readable_.value();
+}
+
+void SPSCReader::acknowledge_event()
+{
+  if ( not readable_ or bytes_buffered() > 0 or closed_.load( memory_order_acquire ) or has_error() ) {
+    return;
+  }
+  readable_->clear();
+  atomic_thread_fence( memory_order_seq_cst );
+  if ( bytes_buffered() > 0 or closed_.load( memory_order_acquire ) or has_error() ) {
+    readable_->notify(); // raced with a push
+  }
+}
+
+SPSCReader& SPSCByteStream::reader()
+{
+  static_assert( sizeof( SPSCReader ) == sizeof( SPSCByteStream ),
+                 "Please add member variables to the SPSCByteStream base, not the SPSCByteStream Reader." );
+
+  return static_cast<SPSCReader&>( *this ); // NOLINT(*-downcast)
+}
+
+const SPSCReader& SPSCByteStream::reader() const
+{
+  static_assert( sizeof( SPSCReader ) == sizeof( SPSCByteStream ),
+                 "Please add member variables to the SPSCByteStream base, not the SPSCByteStream Reader." );
+
+  return static_cast<const SPSCReader&>( *this ); // NOLINT(*-downcast)
+}
+
+SPSCWriter& SPSCByteStream::writer()
+{
+  static_assert( sizeof( SPSCWriter ) == sizeof( SPSCByteStream ),
+                 "Please add member variables to the SPSCByteStream base, not the SPSCByteStream Writer." );
+
+  return static_cast<SPSCWriter&>( *this ); // NOLINT(*-downcast)
+}
+
+const SPSCWriter& SPSCByteStream::writer() const
+{
+  static_assert( sizeof( SPSCWriter ) == sizeof( SPSCByteStream ),
+                 "Please add member variables to the SPSCByteStream base, not the SPSCByteStream Writer." );
+
+  return static_cast<const SPSCWriter&>( *this ); // NOLINT(*-downcast)
+}
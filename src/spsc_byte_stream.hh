@@ -0,0 +1,99 @@
+#pragma once
+
+#include "event_fd.hh"
+#include "mirrored_buffer.hh"
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+class SPSCReader;
+class SPSCWriter;
+
+/*
+ * An SPSCByteStream is a ByteStream that can be shared by two threads without a lock: one thread
+ * (the producer) uses only the writer() interface, and the other (the consumer) only the reader() interface.
+ *
+ * The byte counters are published with release/acquire ordering and kept on separate cache lines, so
+ * the two threads only share a cache line when one of them has to re-read the other's counter.
+ *
+ * Optionally, the stream maintains two eventfds that a thread can poll while waiting for the other:
+ * readable_event() is set while there are bytes to read (or the stream is closed), and writable_event() is set
+ * while there is room to write. They are only signaled on the empty->non-empty and full->not-full transitions;
+ * a thread that has drained (or filled) the stream calls acknowledge_event() to reset its event.
+ */
+class SPSCByteStream
+{
+public:
+  explicit SPSCByteStream( uint64_t capacity, bool with_events = false );
+
+  // Helper functions to access the SPSCByteStream's Reader and Writer interfaces
+  SPSCReader& reader();
+  const SPSCReader& reader() const;
+  SPSCWriter& writer();
+  const SPSCWriter& writer() const;
+
+  void set_error();      // Signal that the stream suffered an error (from either thread).
+  bool has_error() const; // Has the stream had an error?
+
+  // The stream is shared by reference between two threads, so it can be neither copied nor moved.
+  SPSCByteStream( const SPSCByteStream& other ) = delete;
+  SPSCByteStream& operator=( const SPSCByteStream& other ) = delete;
+  SPSCByteStream( SPSCByteStream&& other ) = delete;
+  SPSCByteStream& operator=( SPSCByteStream&& other ) = delete;
+  ~SPSCByteStream() = default;
+
+protected:
+  // Please add any additional state to the SPSCByteStream here, and not to the Writer and Reader interfaces.
+  static constexpr size_t kCacheLine = 64;
+
+  // Shared, read-mostly state
+  uint64_t capacity_;
+  MirroredBuffer buffer_;
+  std::optional<EventFD> readable_ {};
+  std::optional<EventFD> writable_ {};
+  std::atomic<bool> error_ {};
+
+  // Producer-owned state
+  alignas( kCacheLine ) std::atomic<uint64_t> bytes_pushed_ {};
+  std::atomic<bool> closed_ {};
+  mutable uint64_t producer_popped_cache_ {}; // last value of bytes_popped_ seen by the producer
+
+  // Consumer-owned state
+  alignas( kCacheLine ) std::atomic<uint64_t> bytes_popped_ {};
+  mutable uint64_t consumer_pushed_cache_ {}; // last value of bytes_pushed_ seen by the consumer
+};
+
+class SPSCWriter : public SPSCByteStream
+{
+public:
+  uint64_t push( std::string_view data ); // Push as much of data as fits; returns how many bytes were pushed.
+  void close();                           // Signal that the stream has reached its ending.
+
+  bool is_closed() const;              // Has the stream been closed?
+  uint64_t available_capacity() const; // How many bytes can be pushed to the stream right now?
+  uint64_t bytes_pushed() const;       // Total number of bytes cumulatively pushed to the stream
+
+  // Event to poll while waiting for room to write (only with `with_events`)
+  FileDescriptor& writable_event();
+  void acknowledge_event(); // Reset writable_event() if the stream is full
+};
+
+class SPSCReader : public SPSCByteStream
+{
+public:
+  // Peek at the buffered bytes (contiguous). To stay off the producer's cache line, this only looks for newly
+  // pushed bytes once the bytes it already knew about have been popped, so it can return a prefix of what
+  // bytes_buffered() reports -- but never an empty view while bytes are buffered.
+  std::string_view peek() const;
+  void pop( uint64_t len ); // Remove `len` bytes from the buffer
+
+  bool is_finished() const;        // Is the stream finished (closed and fully popped)?
+  uint64_t bytes_buffered() const; // Number of bytes currently buffered (pushed and not popped)
+  uint64_t bytes_popped() const;   // Total number of bytes cumulatively popped from stream
+
+  // Event to poll while waiting for bytes to read (only with `with_events`)
+  FileDescriptor& readable_event();
+  void acknowledge_event(); // Reset readable_event() if the stream is empty and still open
+};
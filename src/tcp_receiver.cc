@@ -1,40 +1,95 @@
 #include "tcp_receiver.hh"
 #include "debug.hh"
+#include "tcp_config.hh"
+
+#include <algorithm>
 
 using namespace std;
 
 void TCPReceiver::receive( TCPSenderMessage message )
 {
-  if ( message.RST ) {
-    reassembler_.reader().set_error();
-    return;
-  }
+  receive( span { &message, 1 } );
+}
+
+void TCPReceiver::receive( span<TCPSenderMessage> messages )
+{
+  batch_.clear();
+  for ( auto& message : messages ) {
+    if ( message.RST ) {
+      insert_batch(); // (what arrived before the reset is still received)
+      reassembler_.reader().set_error();
+      return;
+    }
+    if ( PAWS_reject( message ) ) {
+      continue;
+    }
+
+    if ( !status && message.SYN ) {
+      zero_point_ = message.seqno;
+      SACK_permitted_ = message.SACK_permitted;
+      status = 1;
+    }
 
-  if ( !status && message.SYN ) {
-    zero_point_ = message.seqno;
-    status = 1;
+    if ( status == 1 || status == 2 ) {
+      // The SYN takes absolute sequence number 0, so the payload begins one stream index earlier than its
+      // absolute sequence number -- unless the segment carries the SYN.
+      const uint64_t seqno = message.seqno.unwrap( zero_point_, ackno_ );
+      const uint64_t first_index = seqno + message.SYN - 1;
+      // Echo the timestamp of a segment that begins at or before the ackno, so that the sender's RTT samples
+      // include the time that out-of-order data waited for the hole before it to be filled
+      if ( message.timestamp.has_value() and seqno <= ackno_ ) {
+        TS_recent_ = message.timestamp;
+      }
+      if ( seqno == 0 and not message.SYN ) {
+        continue; // (a zero-window probe or keep-alive, from before the first byte: there is no stream index)
+      }
+      if ( not message.payload.empty() ) {
+        last_index_ = first_index + message.payload.size() - 1;
+      }
+      batch_.push_back( { first_index, move( message.payload ), message.FIN } );
+      status = 2;
+    }
   }
 
-  if ( status == 1 || status == 2 ) {
+  insert_batch();
+}
 
-    uint64_t first_index = message.seqno.unwrap( zero_point_, ackno_ ) - ( status == 2 );
-    uint64_t origin_bytes_pushed = reassembler_.writer().bytes_pushed();
-    reassembler_.insert( first_index, message.payload, message.FIN );
+void TCPReceiver::insert_batch()
+{
+  if ( batch_.empty() ) {
+    return;
+  }
+  reassembler_.insert_many( batch_ );
+  batch_.clear();
 
-    if ( reassembler_.writer().has_error() ) {
-      return;
-    }
+  if ( reassembler_.writer().has_error() ) {
+    return;
+  }
 
-    uint64_t push_len = reassembler_.writer().bytes_pushed() - origin_bytes_pushed;
+  ackno_ = 1 + reassembler_.writer().bytes_pushed();
+  if ( reassembler_.writer().is_closed() ) {
+    status = 3;
+    ackno_++;
+  }
+}
 
-    ackno_ = ackno_ + push_len + message.SYN;
+bool TCPReceiver::PAWS_reject( const TCPSenderMessage& message ) const
+{
+  // (A reset is never rejected: it may come from a peer that restarted, with its clock.)
+  return TS_recent_.has_value() and message.timestamp.has_value() and not message.RST
+         and static_cast<int32_t>( *message.timestamp - *TS_recent_ ) < 0;
+}
 
-    status = 2;
-    if ( reassembler_.writer().is_closed() ) {
-      status = 3;
-      ackno_++;
-    }
+bool TCPReceiver::window_update_due( Wrap32 advertised_ackno, uint64_t advertised_window ) const
+{
+  if ( status == 0 or writer().is_closed() ) {
+    return false;
   }
+  const uint64_t known_edge = advertised_ackno.unwrap( zero_point_, ackno_ ) + advertised_window;
+  const uint64_t known_window = known_edge > ackno_ ? known_edge - ackno_ : 0;
+  const uint64_t window = min<uint64_t>( writer().available_capacity(), max_window_ );
+  const uint64_t capacity = writer().available_capacity() + reader().bytes_buffered();
+  return known_window <= window / 2 and window - known_window >= min( TCPConfig::MAX_PAYLOAD_SIZE, capacity / 2 );
 }
 
 TCPReceiverMessage TCPReceiver::send() const
@@ -44,8 +99,16 @@ TCPReceiverMessage TCPReceiver::send() const
     ackno = Wrap32::wrap( ackno_, zero_point_ );
   }
 
-  uint16_t windeow_size = min( writer().available_capacity(), (uint64_t)UINT16_MAX );
+  const auto window_size = static_cast<uint32_t>( min<uint64_t>( writer().available_capacity(), max_window_ ) );
 
-  TCPReceiverMessage message { ackno, windeow_size, reassembler_.writer().has_error() };
+  TCPReceiverMessage message { ackno, window_size, reassembler_.writer().has_error(), TS_recent_ };
+  if ( SACK_permitted_ and reassembler_.count_bytes_pending() > 0 ) {
+    const auto count = reassembler_.stored_intervals( SACK_intervals_, last_index_ );
+    message.SACK_blocks.reserve( count );
+    for ( const auto& interval : span { SACK_intervals_ }.first( count ) ) {
+      message.SACK_blocks.push_back( { Wrap32::wrap( interval.begin + 1, zero_point_ ),
+                                       Wrap32::wrap( interval.end + 1, zero_point_ ) } );
+    }
+  }
   return message;
 }
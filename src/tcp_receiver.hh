@@ -4,6 +4,10 @@
 #include "tcp_receiver_message.hh"
 #include "tcp_sender_message.hh"
 
+#include <array>
+#include <span>
+#include <vector>
+
 class TCPReceiver
 {
 public:
@@ -16,19 +20,48 @@ public:
    */
   void receive( TCPSenderMessage message );
 
-  // The TCPReceiver sends TCPReceiverMessages to the peer's TCPSender.
+  // Receive a burst of TCPSenderMessages at once (e.g. everything read in one wakeup). Their payloads go to
+  // the Reassembler as one batch (see Reassembler::insert_many), which is cheaper than one insert per segment.
+  void receive( std::span<TCPSenderMessage> messages );
+
+  // The TCPReceiver sends TCPReceiverMessages to the peer's TCPSender (with SACK blocks, if its SYN permitted
+  // them: the range holding the most recently received out-of-order segment first, then the others in order).
   TCPReceiverMessage send() const;
 
+  // Has the application read enough, since the window was last advertised (at `advertised_ackno`, with
+  // `advertised_window`), that the sender should hear of it before it asks? Only once the window the sender
+  // knows of is at most half the one now open, and smaller by a segment (or half the capacity) or more (the
+  // receive-side silly window avoidance of RFC 1122, section 4.2.3.3).
+  bool window_update_due( Wrap32 advertised_ackno, uint64_t advertised_window ) const;
+
+  // Is the message older than the last one timestamped (PAWS, RFC 7323)? receive() ignores such messages.
+  bool PAWS_reject( const TCPSenderMessage& message ) const;
+
+  // Once both sides have agreed on window scaling (RFC 7323), the window can be advertised past 64 KiB: up to
+  // UINT16_MAX shifted left by our side's shift count.
+  void scale_window( uint8_t shift ) { max_window_ = uint32_t { UINT16_MAX } << shift; }
+
   // Access the output
   const Reassembler& reassembler() const { return reassembler_; }
   Reader& reader() { return reassembler_.reader(); }
   const Reader& reader() const { return reassembler_.reader(); }
   const Writer& writer() const { return reassembler_.writer(); }
 
+  // What the Reassembler has seen (holes, buffering, reordering, duplicates)
+  Reassembler::Stats reassembly_stats() const { return reassembler_.stats(); }
+
 private:
+  void insert_batch(); // insert batch_ (and clear it), and move the ackno past what it completes
+
   Reassembler reassembler_;
   // 0-origin, 1-hadSYN, 2-transmitting, 3-hadFIN
   int64_t status {};
   Wrap32 zero_point_ { 0 };
   uint64_t ackno_ {};
+  uint32_t max_window_ { UINT16_MAX };
+  bool SACK_permitted_ {};
+  uint64_t last_index_ {}; // the stream index of the last payload byte received
+  std::optional<uint32_t> TS_recent_ {}; // the timestamp to echo (TS.Recent)
+  std::vector<Reassembler::Segment> batch_ {}; // (kept between bursts to reuse its storage)
+  mutable std::array<Reassembler::Interval, TCPReceiverMessage::MAX_SACK_BLOCKS> SACK_intervals_ {}; // (for send())
 };
@@ -2,8 +2,43 @@
 #include "debug.hh"
 #include "tcp_config.hh"
 
+#include <algorithm>
+
 using namespace std;
 
+namespace {
+constexpr uint64_t clock_granularity_us = 1000;      // (time is counted in whole milliseconds)
+constexpr uint64_t max_pacing_burst_ms = 10;         // (what an event loop ticking every 10 ms needs)
+constexpr uint64_t max_persist_interval_ms = 60'000; // (as for the RTO, in RFC 6298)
+} // namespace
+
+TCPSender::TCPSender( ByteStream&& input, const TCPConfig& config )
+  : TCPSender( std::move( input ), config.isn, config.rt_timeout )
+{
+  adaptive_RTO_ = config.adaptive_rto;
+  if ( adaptive_RTO_ ) {
+    min_RTO_ms_ = config.rto_min;
+    max_RTO_ms_ = max( config.rto_max, config.rto_min );
+  }
+  congestion_control_ = CongestionControl::make( config.congestion_control, TCPConfig::MAX_PAYLOAD_SIZE );
+  fast_retransmit_ = config.fast_retransmit;
+  SACK_ = config.sack;
+  if ( config.window_scaling ) {
+    window_scale_ = config.window_shift();
+  }
+  timestamps_ = config.timestamps;
+  pacing_ = config.pacing;
+  persist_ = config.persist_timer;
+}
+
+optional<uint32_t> TCPSender::timestamp() const
+{
+  if ( not timestamps_ ) {
+    return nullopt;
+  }
+  return static_cast<uint32_t>( now_ms_ );
+}
+
 // This function is for testing only; don't add extra state to support it.
 uint64_t TCPSender::sequence_numbers_in_flight() const
 {
@@ -17,56 +52,136 @@ uint64_t TCPSender::consecutive_retransmissions() const
   return consecutive_retransmissions_;
 }
 
-void TCPSender::push( const TransmitFunction& transmit )
+void TCPSender::do_push()
 {
+  if ( retransmit_front_ ) {
+    retransmit_front_ = false;
+    if ( !messages_in_flight_.empty() ) {
+      resend( messages_in_flight_.front() );
+    }
+  }
+  const bool SACK_recovery = in_fast_recovery_ && SACK_seen_;
+  if ( SACK_recovery ) {
+    retransmit_holes();
+  }
+
   if ( is_closed_ ) {
     return;
   }
 
-  uint16_t had_push = sequence_numbers_in_flight();
-  while ( had_push < receiver_window_size_ ) {
+  const uint64_t window = send_window();
+  const bool paced = pacing_rate().has_value();
+  bool held_by_pacer = false;
+  uint64_t had_push = sequence_numbers_in_flight();
+  while ( had_push < window ) {
+    if ( paced && pacing_credit_ <= 0 ) {
+      held_by_pacer = bytes_unsent() > 0;
+      break;
+    }
 
-    uint16_t msg_size = uint16_t( receiver_window_size_ - had_push );
+    uint64_t msg_size = window - had_push;
 
-    bool RST = reader().has_error();
     bool SYN {};
     if ( abs_seqno_ == 0 ) {
       SYN = true;
       had_ackno_ = isn_;
     }
-    bool FIN = ( reader().bytes_buffered() < (uint64_t)( msg_size - SYN ) ) && writer().is_closed();
-    uint16_t payload_size = msg_size - SYN - FIN;
-    if ( payload_size > TCPConfig::MAX_PAYLOAD_SIZE && reader().bytes_buffered() > TCPConfig::MAX_PAYLOAD_SIZE ) {
+    const uint64_t unsent = bytes_unsent();
+    bool FIN = ( unsent < msg_size - SYN ) && writer().is_closed();
+    uint64_t payload_size = min( msg_size - SYN - FIN, unsent );
+    if ( payload_size > TCPConfig::MAX_PAYLOAD_SIZE ) {
       FIN = false;
       payload_size = TCPConfig::MAX_PAYLOAD_SIZE;
     }
-    string payload;
-    read( reader(), payload_size, payload );
 
-    TCPSenderMessage message { Wrap32::wrap( abs_seqno_, isn_ ), SYN, payload, FIN, RST };
-    if ( message.sequence_length() == 0 ) {
+    const Outstanding segment { current_RTO_ms_, abs_seqno_, SYN + payload_size + FIN, SYN, FIN, now_ms_ };
+    if ( segment.length == 0 ) {
       break;
     }
-    messages_in_flight_.emplace_back( current_RTO_ms_, message );
-    transmit( message );
-    had_push += message.sequence_length();
-    abs_seqno_ += message.sequence_length();
+    messages_in_flight_.push_back( segment );
+    ready_.push_back( segment );
+    if ( paced ) {
+      pacing_credit_ -= static_cast<int64_t>( segment.length );
+    }
+    had_push += segment.length;
+    abs_seqno_ += segment.length;
+    bytes_sent_ += payload_size;
 
-    if ( message.FIN ) {
+    if ( FIN ) {
       is_closed_ = true;
       break;
     }
   }
+
+  // (The congestion window only grows while it is what holds the sender back -- or the pacer, which lets it out
+  // within the round trip.)
+  cwnd_limited_ = congestion_control_ and ( had_push >= congestion_control_->cwnd() or held_by_pacer );
+  update_persist();
+}
+
+uint64_t TCPSender::send_window() const
+{
+  uint64_t window = receiver_window_size_;
+  if ( window == 0 && !persist_ ) {
+    window = 1; // (a byte into the closed window, to probe it)
+  }
+  if ( congestion_control_ ) {
+    // (With SACK, the segments that have left the network are known, rather than counted from duplicate ACKs.)
+    const bool SACK_recovery = in_fast_recovery_ && SACK_seen_;
+    const uint64_t inflation = SACK_recovery ? sequence_numbers_in_flight() - pipe() : recovery_inflation_;
+    window = min( window, congestion_control_->cwnd() + inflation );
+  }
+  return window;
+}
+
+void TCPSender::update_persist()
+{
+  const bool FIN_unsent = writer().is_closed() && !is_closed_;
+  const bool waiting
+    = receiver_window_size_ == 0 && ( !messages_in_flight_.empty() || bytes_unsent() > 0 || FIN_unsent );
+  if ( persist_ && waiting ) {
+    if ( !persist_remain_ms_.has_value() ) {
+      persist_interval_ms_ = RTO_ms_;
+      persist_remain_ms_ = persist_interval_ms_;
+    }
+    return;
+  }
+
+  if ( persist_remain_ms_.has_value() ) {
+    // The window is open: the retransmission timer starts over
+    persist_remain_ms_.reset();
+    if ( !messages_in_flight_.empty() ) {
+      messages_in_flight_.front().remain_time = current_RTO_ms_;
+    }
+  }
+}
+
+TCPSenderMessage TCPSender::make_message( const Outstanding& segment )
+{
+  TCPSenderMessage message { Wrap32::wrap( segment.seqno, isn_ ),
+                             segment.SYN,
+                             {},
+                             segment.FIN,
+                             reader().has_error(),
+                             segment.SYN && SACK_,
+                             segment.SYN ? window_scale_ : nullopt,
+                             timestamp() };
+  // (The SYN takes absolute sequence number 0, so the payload's stream index is one less than its seqno.)
+  const uint64_t first_index = segment.seqno + segment.SYN - 1;
+  const uint64_t payload_size = segment.length - segment.SYN - segment.FIN;
+  message.payload = input_.chunk_pool().take( payload_size );
+  message.payload.assign( reader().peek().substr( first_index - reader().bytes_popped(), payload_size ) );
+  return message;
 }
 
 TCPSenderMessage TCPSender::make_empty_message() const
 {
   Wrap32 seqno = Wrap32::wrap( abs_seqno_, isn_ );
   bool RST = reader().has_error();
-  return TCPSenderMessage { seqno, false, "", false, RST };
+  return TCPSenderMessage { seqno, false, "", false, RST, false, nullopt, timestamp() };
 }
 
-void TCPSender::receive( const TCPReceiverMessage& msg )
+void TCPSender::receive( const TCPReceiverMessage& msg, bool pure_ACK )
 {
   if ( msg.RST ) {
     reader().set_error();
@@ -74,32 +189,73 @@ void TCPSender::receive( const TCPReceiverMessage& msg )
     messages_in_flight_.clear();
   }
 
-  uint16_t window_size = msg.window_size;
+  uint32_t window_size = msg.window_size;
   if ( msg.ackno.has_value() ) {
     uint64_t ackno = msg.ackno.value().unwrap( isn_, abs_seqno_ );
     uint64_t had_ackno = had_ackno_.unwrap( isn_, abs_seqno_ );
+    if ( SACK_ && ackno >= had_ackno && ackno <= abs_seqno_ ) {
+      update_scoreboard( msg.SACK_blocks );
+    }
+    // (An ACK on a data segment, or one that answers a probe of a closed window, reports no loss.)
+    if ( fast_retransmit_ && pure_ACK && ackno == had_ackno && !messages_in_flight_.empty() && window_size > 0
+         && window_size == receiver_window_size_ ) {
+      duplicate_ACK();
+    }
     if ( ( ackno > had_ackno && ackno <= abs_seqno_ ) ) {
 
-      if ( window_size == 0 ) {
-        is_fill_ = true;
-      }
-      receiver_window_size_ = window_size == 0 ? 1 : window_size;
-      current_RTO_ms_ = initial_RTO_ms_;
+      receiver_window_size_ = window_size;
       consecutive_retransmissions_ = 0;
       had_ackno_ = msg.ackno.value();
 
+      // Karn's rule: an ACK that covers a retransmitted segment may have been sent for either copy (and the
+      // segments after it may have waited at the receiver for the retransmission), so it gives no sample.
+      optional<uint64_t> RTT_ms;
+      bool ambiguous = false;
       while ( !messages_in_flight_.empty() ) {
-        auto& [remain_time, message] = messages_in_flight_.front();
-        uint64_t seqno = message.seqno.unwrap( isn_, abs_seqno_ );
-        if ( seqno + message.sequence_length() <= ackno ) {
+        const auto& front = messages_in_flight_.front();
+        if ( front.seqno + front.length <= ackno ) {
+          ambiguous |= front.retransmitted;
+          RTT_ms = now_ms_ - front.sent_at_ms;
           messages_in_flight_.pop_front();
         } else {
           break;
         }
       }
+      // Release the acknowledged bytes from the outbound stream (up to the first outstanding segment, in case
+      // it has to be sent again)
+      const uint64_t keep_from = messages_in_flight_.empty()
+                                   ? bytes_sent_
+                                   : messages_in_flight_.front().seqno + messages_in_flight_.front().SYN - 1;
+      reader().pop( keep_from - reader().bytes_popped() );
+      if ( timestamps_ and msg.timestamp_echo.has_value() ) {
+        // The echo says which transmission this acknowledges, so retransmitted segments give samples too
+        const auto echoed_RTT_ms = static_cast<uint32_t>( now_ms_ ) - *msg.timestamp_echo;
+        if ( static_cast<int32_t>( echoed_RTT_ms ) >= 0 ) { // (not an echo from the future)
+          sample_RTT( echoed_RTT_ms );
+        }
+      } else if ( RTT_ms.has_value() and not ambiguous ) {
+        sample_RTT( *RTT_ms );
+      }
+      duplicate_ACKs_ = 0;
+      if ( in_fast_recovery_ ) {
+        if ( ackno >= recover_ ) {
+          // A full ACK: every loss in the window is repaired (cwnd is already back to ssthresh)
+          in_fast_recovery_ = false;
+          recovery_inflation_ = 0;
+        } else {
+          // A partial ACK: the next hole is the first outstanding segment (unless SACK already had it resent).
+          // Deflate by what was acknowledged, less the segment that repairs it.
+          retransmit_front_ = !messages_in_flight_.empty() && !messages_in_flight_.front().resent_in_recovery;
+          const uint64_t acked = ackno - had_ackno;
+          recovery_inflation_ = ( recovery_inflation_ > acked ? recovery_inflation_ - acked : 0 )
+                                + TCPConfig::MAX_PAYLOAD_SIZE;
+        }
+      } else if ( congestion_control_ and cwnd_limited_ ) {
+        congestion_control_->on_ack( ackno - had_ackno, now_ms_, SRTT_us_.value_or( 0 ) / 1000 );
+      }
+      current_RTO_ms_ = RTO_ms_;
       if ( !messages_in_flight_.empty() ) {
-        auto& [remain_time, message] = messages_in_flight_.front();
-        remain_time = current_RTO_ms_;
+        messages_in_flight_.front().remain_time = current_RTO_ms_;
       }
     }
   }
@@ -107,23 +263,192 @@ void TCPSender::receive( const TCPReceiverMessage& msg )
   if ( window_size > receiver_window_size_ ) {
     receiver_window_size_ = window_size;
   }
+  update_persist();
+}
+
+void TCPSender::duplicate_ACK()
+{
+  duplicate_ACKs_++;
+  if ( in_fast_recovery_ ) {
+    recovery_inflation_ += TCPConfig::MAX_PAYLOAD_SIZE; // another segment has left the network
+    return;
+  }
+
+  // (Only for data sent after the last recovery or timeout began, so that the duplicates of segments already
+  // retransmitted don't start another one.)
+  if ( duplicate_ACKs_ == 3 && had_ackno_.unwrap( isn_, abs_seqno_ ) > recover_ ) {
+    in_fast_recovery_ = true;
+    for ( auto& segment : messages_in_flight_ ) {
+      segment.resent_in_recovery = false;
+    }
+    recover_ = abs_seqno_;
+    retransmit_front_ = true;
+    if ( congestion_control_ ) {
+      congestion_control_->on_loss( sequence_numbers_in_flight(), now_ms_ );
+      recovery_inflation_ = 3 * TCPConfig::MAX_PAYLOAD_SIZE;
+    }
+  }
+}
+
+void TCPSender::update_scoreboard( const vector<TCPReceiverMessage::SACKBlock>& blocks )
+{
+  for ( const auto& block : blocks ) {
+    const uint64_t begin = block.begin.unwrap( isn_, abs_seqno_ );
+    const uint64_t end = block.end.unwrap( isn_, abs_seqno_ );
+    if ( begin >= end || end > abs_seqno_ ) {
+      continue; // (not a block of data we sent)
+    }
+    SACK_seen_ = true;
+    for ( auto& segment : messages_in_flight_ ) {
+      const uint64_t segment_end = segment.seqno + segment.length;
+      if ( segment.seqno >= end ) {
+        break;
+      }
+      if ( segment.seqno >= begin && segment_end <= end ) {
+        segment.SACKed = true;
+        highest_SACKed_ = max( highest_SACKed_, segment_end );
+      }
+    }
+  }
+}
+
+uint64_t TCPSender::pipe() const
+{
+  uint64_t bytes = 0;
+  for ( const auto& segment : messages_in_flight_ ) {
+    const bool lost = segment.seqno + segment.length <= highest_SACKed_;
+    if ( !segment.SACKed && ( !lost || segment.resent_in_recovery ) ) {
+      bytes += segment.length;
+    }
+  }
+  return bytes;
+}
+
+void TCPSender::resend( Outstanding& segment )
+{
+  ready_.push_back( segment );
+  segment.retransmitted = true;
+  segment.resent_in_recovery = in_fast_recovery_;
+  segment.remain_time = current_RTO_ms_;
+}
+
+void TCPSender::retransmit_holes()
+{
+  uint64_t bytes_in_network = pipe();
+  for ( auto& segment : messages_in_flight_ ) {
+    if ( segment.seqno + segment.length > highest_SACKed_ ) {
+      break; // (not known to be lost)
+    }
+    if ( congestion_control_ && bytes_in_network >= congestion_control_->cwnd() ) {
+      break;
+    }
+    if ( !segment.SACKed && !segment.resent_in_recovery ) {
+      resend( segment );
+      bytes_in_network += segment.length;
+    }
+  }
 }
 
-void TCPSender::tick( uint64_t ms_since_last_tick, const TransmitFunction& transmit )
+void TCPSender::sample_RTT( uint64_t RTT_ms )
 {
-  uint64_t double_RTO = current_RTO_ms_ * 2;
+  const uint64_t R = RTT_ms * 1000;
+  if ( not SRTT_us_.has_value() ) {
+    SRTT_us_ = R;
+    RTTVAR_us_ = R / 2;
+  } else {
+    const uint64_t error = *SRTT_us_ > R ? *SRTT_us_ - R : R - *SRTT_us_;
+    RTTVAR_us_ = ( 3 * RTTVAR_us_ + error ) / 4;
+    SRTT_us_ = ( 7 * *SRTT_us_ + R ) / 8;
+  }
+  if ( adaptive_RTO_ ) {
+    const uint64_t RTO_us = *SRTT_us_ + max( clock_granularity_us, 4 * RTTVAR_us_ );
+    RTO_ms_ = clamp( ( RTO_us + 999 ) / 1000, min_RTO_ms_, max_RTO_ms_ );
+  }
+}
 
-  if ( !messages_in_flight_.empty() ) {
-    auto& [remain_time, message] = messages_in_flight_.front();
-    if ( remain_time <= ms_since_last_tick ) {
-      transmit( message );
-      if ( !is_fill_ ) {
+optional<uint64_t> TCPSender::pacing_rate() const
+{
+  if ( not pacing_ or not SRTT_us_.has_value() ) {
+    return nullopt;
+  }
+  uint64_t window = receiver_window_size_;
+  uint64_t gain_percent = 120;
+  if ( congestion_control_ ) {
+    window = congestion_control_->cwnd();
+    if ( window < congestion_control_->ssthresh() ) {
+      gain_percent = 200; // (slow start, to keep doubling each round trip)
+    }
+  }
+  return window * gain_percent * 10'000 / max<uint64_t>( *SRTT_us_, 1 ); // (window * gain / SRTT)
+}
+
+optional<uint64_t> TCPSender::pacing_delay_ms() const
+{
+  const auto rate = pacing_rate();
+  if ( not rate.has_value() or is_closed_ or bytes_unsent() == 0 ) {
+    return nullopt;
+  }
+  if ( sequence_numbers_in_flight() >= send_window() ) {
+    return nullopt; // (what's unsent waits for the windows, not the pacer)
+  }
+  if ( pacing_credit_ > 0 ) {
+    return 0;
+  }
+  const auto deficit = static_cast<uint64_t>( 1 - pacing_credit_ );
+  return ( deficit * 1000 + *rate - 1 ) / max<uint64_t>( *rate, 1 );
+}
+
+void TCPSender::do_tick( uint64_t ms_since_last_tick )
+{
+  now_ms_ += ms_since_last_tick;
+  uint64_t double_RTO = min( current_RTO_ms_ * 2, max_RTO_ms_ );
+
+  if ( persist_remain_ms_.has_value() ) {
+    if ( *persist_remain_ms_ <= ms_since_last_tick ) {
+      // The probe is an empty segment just before the ackno, which the receiver answers with its window.
+      // (Rather than new data: that could only be dropped, outside the closed window.)
+      TCPSenderMessage probe = make_empty_message();
+      probe.seqno = had_ackno_ + UINT32_MAX; // (had_ackno_ - 1)
+      probe_ = move( probe );
+      persist_interval_ms_ = min( persist_interval_ms_ * 2, max_persist_interval_ms );
+      persist_remain_ms_ = persist_interval_ms_;
+    } else {
+      *persist_remain_ms_ -= ms_since_last_tick;
+    }
+  } else if ( !messages_in_flight_.empty() ) {
+    auto& front = messages_in_flight_.front();
+    if ( front.remain_time <= ms_since_last_tick ) {
+      ready_.push_back( front );
+      front.retransmitted = true;
+      if ( receiver_window_size_ > 0 ) { // (otherwise, the segment was a probe of the closed window)
+        if ( consecutive_retransmissions_ == 0 ) {
+          if ( congestion_control_ ) {
+            congestion_control_->on_rto( sequence_numbers_in_flight(), now_ms_ );
+          }
+          in_fast_recovery_ = false;
+          recovery_inflation_ = 0;
+          duplicate_ACKs_ = 0;
+          recover_ = abs_seqno_;
+        }
+        // The receiver may have dropped what it SACKed (RFC 2018, section 8)
+        for ( auto& segment : messages_in_flight_ ) {
+          segment.SACKed = false;
+        }
+        highest_SACKed_ = 0;
         current_RTO_ms_ = double_RTO;
         consecutive_retransmissions_++;
       }
-      remain_time = current_RTO_ms_;
+      front.remain_time = current_RTO_ms_;
     } else {
-      remain_time -= ms_since_last_tick;
+      front.remain_time -= ms_since_last_tick;
     }
   }
+
+  // Refill the pacer's bucket, and send what it lets out. (An idle sender doesn't save up for a burst: the bucket
+  // holds two segments, or a coarse tick's worth.)
+  if ( const auto rate = pacing_rate() ) {
+    const auto depth = max<int64_t>( *rate * max_pacing_burst_ms / 1000, 2 * TCPConfig::MAX_PAYLOAD_SIZE );
+    pacing_credit_ = min( pacing_credit_ + static_cast<int64_t>( *rate * ms_since_last_tick / 1000 ), depth );
+    do_push();
+  }
 }
@@ -1,11 +1,18 @@
 #pragma once
 
 #include "byte_stream.hh"
+#include "congestion_control.hh"
+#include "tcp_config.hh"
 #include "tcp_receiver_message.hh"
 #include "tcp_sender_message.hh"
 
+#include <concepts>
 #include <deque>
 #include <functional>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <vector>
 
 class TCPSender
 {
@@ -15,23 +22,44 @@ public:
     : input_( std::move( input ) )
     , isn_( isn )
     , initial_RTO_ms_( initial_RTO_ms )
+    , RTO_ms_( initial_RTO_ms )
     , current_RTO_ms_( initial_RTO_ms )
   {}
 
+  /* Construct TCP sender from a TCPConfig: its ISN and initial RTO, and the features it enables (e.g. adaptive
+     RTO, congestion control). The constructor above leaves them all off. */
+  TCPSender( ByteStream&& input, const TCPConfig& config );
+
   /* Generate an empty TCPSenderMessage */
   TCPSenderMessage make_empty_message() const;
 
-  /* Receive and process a TCPReceiverMessage from the peer's receiver */
-  void receive( const TCPReceiverMessage& msg );
+  /* Receive and process a TCPReceiverMessage from the peer's receiver. `pure_ACK` says whether the segment that
+     carried it occupied no sequence numbers: only such an ACK can be a duplicate (RFC 5681, section 2). */
+  void receive( const TCPReceiverMessage& msg, bool pure_ACK = true );
 
   /* Type of the `transmit` function that the push and tick methods can use to send messages */
   using TransmitFunction = std::function<void( const TCPSenderMessage& )>;
 
-  /* Push bytes from the outbound stream */
-  void push( const TransmitFunction& transmit );
+  /* Push bytes from the outbound stream (as many as the receiver's window, and the congestion window, allow) */
+  template<std::invocable<const TCPSenderMessage&> T>
+  void push( const T& transmit )
+  {
+    do_push();
+    transmit_ready( transmit );
+  }
+  void push( const TransmitFunction& transmit ) { push<TransmitFunction>( transmit ); }
 
   /* Time has passed by the given # of milliseconds since the last time the tick() method was called */
-  void tick( uint64_t ms_since_last_tick, const TransmitFunction& transmit );
+  template<std::invocable<const TCPSenderMessage&> T>
+  void tick( uint64_t ms_since_last_tick, const T& transmit )
+  {
+    do_tick( ms_since_last_tick );
+    transmit_ready( transmit );
+  }
+  void tick( uint64_t ms_since_last_tick, const TransmitFunction& transmit )
+  {
+    tick<TransmitFunction>( ms_since_last_tick, transmit );
+  }
 
   // Accessors
   uint64_t sequence_numbers_in_flight() const;  // For testing: how many sequence numbers are outstanding?
@@ -40,19 +68,131 @@ public:
   const Reader& reader() const { return input_.reader(); }
   Writer& writer() { return input_.writer(); }
 
+  // The retransmission timeout, before any backoff, and the smoothed round-trip time it was computed from (none
+  // until the first sample) (RFC 6298)
+  uint64_t RTO_ms() const { return RTO_ms_; }
+  std::optional<uint64_t> smoothed_RTT_us() const { return SRTT_us_; }
+
+  // The congestion control algorithm, if any
+  const CongestionControl* congestion_control() const { return congestion_control_.get(); }
+
+  // Has the FIN been sent (if not yet acknowledged)?
+  bool FIN_sent() const { return is_closed_; }
+
+  // Is the sender repairing losses reported by duplicate ACKs (fast recovery)?
+  bool in_fast_recovery() const { return in_fast_recovery_; }
+
+  // The rate at which new segments are paced, in bytes per second (if pacing, once there is an RTT to go by),
+  // and how long until the next may be sent (if one is waiting for the pacer): tick() sends it then.
+  std::optional<uint64_t> pacing_rate() const;
+  std::optional<uint64_t> pacing_delay_ms() const;
+
+  // Stop timestamping segments (the peer's SYN didn't offer timestamps)
+  void disable_timestamps() { timestamps_ = false; }
+
 private:
+  // do_push() and do_tick() queue what they send, in order, and push() and tick() then hand it to the transmit
+  // function here, where the call can be inlined (with no indirect call per segment, unless it is a std::function)
+  void do_push();
+  void do_tick( uint64_t ms_since_last_tick );
+  template<typename T>
+  void transmit_ready( const T& transmit )
+  {
+    if ( probe_.has_value() ) {
+      transmit( *probe_ );
+      probe_.reset();
+    }
+    for ( const auto& segment : ready_ ) {
+      TCPSenderMessage message = make_message( segment );
+      transmit( message );
+      input_.chunk_pool().give( std::move( message.payload ) ); // (the transmit function has copied what it keeps)
+    }
+    ready_.clear();
+  }
+  uint64_t send_window() const; // how far the flight may reach: the receiver's window, and the congestion window
+
   Reader& reader() { return input_.reader(); }
   uint64_t abs_seqno_ {};
   Wrap32 had_ackno_ { 0 };
-  uint16_t receiver_window_size_ { 1 };
-  // <remain_time(initial set as RTO), message>
-  std::deque<std::pair<uint64_t, TCPSenderMessage>> messages_in_flight_ {};
+  uint32_t receiver_window_size_ { 1 }; // (as advertised: it may be zero)
+  // A segment sent and not yet acknowledged, by its sequence numbers. Its payload stays in the outbound stream
+  // (which is only popped as it is acknowledged), and each transmission is built from there.
+  struct Outstanding
+  {
+    uint64_t remain_time; // (initially set as RTO)
+    uint64_t seqno;       // absolute sequence number of its first byte (the SYN, if any)
+    uint64_t length;      // sequence numbers it uses (SYN and FIN included)
+    bool SYN;
+    bool FIN;
+    uint64_t sent_at_ms;  // when it was first sent
+    bool retransmitted {};
+    bool SACKed {};             // the receiver reported holding it
+    bool resent_in_recovery {}; // (in the current fast recovery)
+  };
+  std::deque<Outstanding> messages_in_flight_ {};
+  uint64_t bytes_sent_ {}; // stream index of the first byte not yet sent
+  std::vector<Outstanding> ready_ {};        // segments to transmit, as they were when sent
+  std::optional<TCPSenderMessage> probe_ {}; // a zero-window probe to transmit (before them)
+  TCPSenderMessage make_message( const Outstanding& segment ); // (its payload buffer from the stream's pool)
+  uint64_t bytes_unsent() const { return reader().bytes_popped() + reader().bytes_buffered() - bytes_sent_; }
   bool is_closed_ {};
-  bool is_fill_ {};
   uint64_t consecutive_retransmissions_ {};
 
   ByteStream input_;
   Wrap32 isn_;
   uint64_t initial_RTO_ms_;
-  uint64_t current_RTO_ms_;
+  uint64_t RTO_ms_;         // RTO before backoff: initial_RTO_ms_ until the first RTT sample (if adaptive)
+  uint64_t current_RTO_ms_; // RTO with backoff
+
+  // RFC 6298 estimation, from the timestamp echoed in each ACK (RFC 7323), or without timestamps, from ACKs of
+  // segments that were never retransmitted (Karn's rule). (SRTT is kept up to date even with a fixed RTO, for
+  // congestion control.)
+  void sample_RTT( uint64_t RTT_ms );
+  bool adaptive_RTO_ {};
+  uint64_t min_RTO_ms_ {};
+  uint64_t max_RTO_ms_ { std::numeric_limits<uint64_t>::max() };
+  uint64_t now_ms_ {}; // time, as the sum of ticks
+  std::optional<uint64_t> SRTT_us_ {};
+  uint64_t RTTVAR_us_ {};
+
+  std::unique_ptr<CongestionControl> congestion_control_ {};
+  bool cwnd_limited_ {}; // did the congestion window (rather than the receiver's, or a lack of data) stop push()?
+
+  // Fast retransmit and NewReno fast recovery (RFC 5681, RFC 6582). receive() has no way to transmit, so it
+  // leaves the retransmission to the push() that follows it.
+  void duplicate_ACK();
+  bool fast_retransmit_ {};
+  uint64_t duplicate_ACKs_ {};
+  bool in_fast_recovery_ {};
+  uint64_t recover_ {};             // the highest sequence number sent when recovery (or a timeout) began
+  uint64_t recovery_inflation_ {};  // how far past cwnd the flight may go, for segments that have left the network
+  bool retransmit_front_ {};        // retransmit the first outstanding segment at the next push()
+
+  // SACK scoreboard (RFC 2018; recovery after RFC 6675). Outstanding segments that the receiver reports holding
+  // are marked, and are never resent during fast recovery (though they stay queued until cumulatively acked,
+  // in case the receiver drops them). A segment with SACKed data beyond it is taken to be lost.
+  void update_scoreboard( const std::vector<TCPReceiverMessage::SACKBlock>& blocks );
+  uint64_t pipe() const; // bytes believed to be in the network: not SACKed, and not lost (unless resent)
+  void resend( Outstanding& segment );
+  void retransmit_holes();
+  bool SACK_ {};
+  bool SACK_seen_ {};          // has the receiver sent any SACK blocks?
+  uint64_t highest_SACKed_ {}; // the end of the highest SACKed segment
+
+  std::optional<uint8_t> window_scale_ {}; // offered on the SYN (for the TCPPeer to negotiate; see TCPConfig)
+  bool timestamps_ {};
+
+  // Zero-window probing (RFC 9293, section 3.8.6.1). While the receiver's window is closed and something waits
+  // for it, the retransmission timer stops, and a persist timer sends probes (with backoff, but counting as no
+  // retransmission) until an ACK opens the window. Without it, a byte is sent into the closed window, and its
+  // retransmissions don't back off.
+  void update_persist();
+  bool persist_ {};
+  std::optional<uint64_t> persist_remain_ms_ {}; // time until the next probe (while probing)
+  uint64_t persist_interval_ms_ {};
+
+  // Pacing, by a token bucket that tick() refills at pacing_rate(). (A segment may overdraw it.)
+  bool pacing_ {};
+  int64_t pacing_credit_ { 2 * TCPConfig::MAX_PAYLOAD_SIZE }; // bytes
+  std::optional<uint32_t> timestamp() const; // for a segment sent now (if timestamping)
 };
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Counts the program's heap allocations by replacing the global operator new and delete.
+// The replacements must be defined exactly once per program, so only include this header
+// from a test's main .cc file.
+
+struct AllocationCount
+{
+  size_t allocations {};
+  size_t bytes {};
+
+  AllocationCount operator-( const AllocationCount& other ) const
+  {
+    return { allocations - other.allocations, bytes - other.bytes };
+  }
+};
+
+inline AllocationCount& allocation_count()
+{
+  static AllocationCount count;
+  return count;
+}
+
+void* operator new( size_t size )
+{
+  ++allocation_count().allocations;
+  allocation_count().bytes += size;
+  void* ptr = std::malloc( size ? size : 1 ); // NOLINT(*-no-malloc, *-owning-memory)
+  if ( not ptr ) {
+    throw std::bad_alloc {};
+  }
+  return ptr;
+}
+
+void operator delete( void* ptr ) noexcept
+{
+  std::free( ptr ); // NOLINT(*-no-malloc, *-owning-memory)
+}
+
+void operator delete( void* ptr, size_t /* size */ ) noexcept
+{
+  std::free( ptr ); // NOLINT(*-no-malloc, *-owning-memory)
+}
@@ -0,0 +1,188 @@
+#include "bidirectional_stream_copy.hh"
+#include "common.hh"
+#include "random.hh"
+
+#include <array>
+#include <csignal>
+#include <cstdlib>
+#include <exception>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+
+using namespace std;
+
+namespace {
+struct Pipe
+{
+  FileDescriptor read_end;
+  FileDescriptor write_end;
+};
+
+Pipe make_pipe()
+{
+  array<int, 2> fds {};
+  CheckSystemCall( "pipe2", ::pipe2( fds.data(), O_CLOEXEC ) );
+  return { FileDescriptor { fds[0] }, FileDescriptor { fds[1] } };
+}
+
+// A file opened for appending (which splice(2) can't write to), unlinked right away, and a descriptor that reads it
+pair<FileDescriptor, FileDescriptor> make_append_file()
+{
+  const char* tmpdir = getenv( "TMPDIR" ); // NOLINT(*-mt-unsafe)
+  string path = string { tmpdir ? tmpdir : "/tmp" } + "/minnow-copy-XXXXXX";
+  FileDescriptor reader { CheckSystemCall( "mkstemp", mkostemp( path.data(), O_CLOEXEC ) ) };
+  FileDescriptor appender { CheckSystemCall( "open", open( path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC ) ) };
+  CheckSystemCall( "unlink", unlink( path.c_str() ) );
+  return { move( appender ), move( reader ) };
+}
+
+// The two ends of a TCP connection over the loopback interface
+pair<TCPSocket, TCPSocket> make_connection()
+{
+  TCPSocket listener;
+  listener.bind( Address { "127.0.0.1" } );
+  listener.listen();
+  TCPSocket client;
+  client.connect( listener.local_address() );
+  return { move( client ), listener.accept() };
+}
+
+string random_string( size_t len )
+{
+  auto rd = get_random_engine();
+  string ret( len, 0 );
+  for ( auto& ch : ret ) {
+    ch = static_cast<char>( rd() );
+  }
+  return ret;
+}
+
+void write_all( FileDescriptor& fd, string_view data )
+{
+  while ( not data.empty() ) {
+    data.remove_prefix( fd.write( data ) );
+  }
+}
+
+string read_all( FileDescriptor& fd )
+{
+  string ret;
+  string buffer;
+  while ( not fd.eof() ) {
+    buffer.clear();
+    fd.read( buffer );
+    ret += buffer;
+  }
+  return ret;
+}
+
+// Copy between `input`/`output` and one end of a connection, while the other end (the peer) sends `to_output` and
+// receives what arrives from `input`. Returns what the peer received.
+string copy_with_peer( FileDescriptor& input, FileDescriptor& output, const string& to_output )
+{
+  auto [socket, peer] = make_connection();
+  string peer_received;
+  thread peer_reader { [&] { peer_received = read_all( peer ); } };
+  thread peer_writer { [&] {
+    write_all( peer, to_output );
+    peer.shutdown( SHUT_WR );
+  } };
+
+  bidirectional_stream_copy( socket, input, output, "peer" );
+  peer_writer.join();
+  peer_reader.join();
+  return peer_received;
+}
+
+// Pipes at both ends: the bytes are spliced
+void spliced_copy()
+{
+  const string to_peer = random_string( 3'000'000 );
+  const string from_peer = random_string( 2'000'000 );
+
+  Pipe input = make_pipe();
+  Pipe output = make_pipe();
+  check( splice_capable( input.read_end ) and splice_capable( output.write_end ), "pipes can be spliced" );
+
+  thread feeder { [&] {
+    write_all( input.write_end, to_peer );
+    input.write_end.close();
+  } };
+  string received;
+  thread drainer { [&] { received = read_all( output.read_end ); } };
+
+  const string peer_received = copy_with_peer( input.read_end, output.write_end, from_peer );
+  feeder.join();
+  drainer.join();
+
+  check( peer_received == to_peer, "the input arrives at the peer, followed by EOF" );
+  check( received == from_peer, "the peer's bytes arrive at the output, followed by EOF" );
+}
+
+// A file opened for appending as the output: the bytes are copied through user space
+void buffered_copy()
+{
+  const string to_peer = random_string( 3'000'000 );
+  const string from_peer = random_string( 2'000'000 );
+
+  Pipe input = make_pipe();
+  auto [output, output_contents] = make_append_file();
+  check( not splice_capable( output ), "a file opened for appending can't be spliced" );
+
+  thread feeder { [&] {
+    write_all( input.write_end, to_peer );
+    input.write_end.close();
+  } };
+
+  const string peer_received = copy_with_peer( input.read_end, output, from_peer );
+  feeder.join();
+
+  check( peer_received == to_peer, "the input arrives at the peer, followed by EOF" );
+  check( output.closed(), "the output is closed at the end of the peer's bytes" );
+  check( read_all( output_contents ) == from_peer, "the peer's bytes arrive at the output" );
+}
+
+// The peer resets the connection: the copy stops (instead of waiting forever), and nothing reaches the output
+void reset_by_peer( bool spliced )
+{
+  Pipe input = make_pipe();
+  write_all( input.write_end, random_string( 10'000 ) );
+  input.write_end.close();
+
+  Pipe output_pipe = make_pipe();
+  auto [output_file, output_contents] = make_append_file();
+  FileDescriptor& output = spliced ? output_pipe.write_end : output_file;
+
+  auto [socket, peer] = make_connection();
+  const linger abort_on_close { 1, 0 }; // (close with a RST)
+  const int ret = ::setsockopt( peer.fd_num(), SOL_SOCKET, SO_LINGER, &abort_on_close, sizeof( abort_on_close ) );
+  CheckSystemCall( "setsockopt", ret );
+  peer.close();
+
+  bidirectional_stream_copy( socket, input.read_end, output, "peer" );
+
+  output_pipe.write_end.close();
+  check( read_all( spliced ? output_pipe.read_end : output_contents ).empty(), "nothing reaches the output" );
+}
+} // namespace
+
+int main()
+{
+  try {
+    signal( SIGPIPE, SIG_IGN ); // (writing to a reset connection fails with EPIPE, instead of ending the test)
+    spliced_copy();
+    buffered_copy();
+    reset_by_peer( true );
+    reset_by_peer( false );
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -1,3 +1,4 @@
+#include "allocation_counter.hh"
 #include "byte_stream.hh"
 
 #include <chrono>
@@ -7,6 +8,9 @@
 #include <iostream>
 #include <queue>
 #include <random>
+#include <string>
+#include <string_view>
+#include <vector>
 
 using namespace std;
 using namespace std::chrono;
@@ -30,15 +34,26 @@ double speed_test( fstream& debug_output,
   }();
 
   // Split the data into segments before writing
-  queue<string> split_data;
+  queue<string_view> split_data;
   for ( size_t i = 0; i < data.size(); i += write_size ) {
-    split_data.emplace( data.substr( i, write_size ) );
+    split_data.emplace( string_view( data ).substr( i, write_size ) );
   }
 
   ByteStream bs { capacity };
   string output_data;
   output_data.reserve( data.size() );
 
+  // Each segment is copied into a buffer from the stream's pool, as a receiver would fill one, so the stream
+  // has to give its buffers back for the loop to run without allocating. (A few are allocated up front.)
+  vector<string> warm;
+  for ( size_t i = 0; i < 4; ++i ) {
+    warm.push_back( bs.writer().chunk_pool().take( write_size ) );
+  }
+  for ( auto& buffer : warm ) {
+    bs.writer().chunk_pool().give( move( buffer ) );
+  }
+
+  const auto start_allocations = allocation_count();
   const auto start_time = steady_clock::now();
   while ( not bs.reader().is_finished() ) {
     if ( split_data.empty() ) {
@@ -47,7 +62,9 @@ double speed_test( fstream& debug_output,
       }
     } else {
       if ( split_data.front().size() <= bs.writer().available_capacity() ) {
-        bs.writer().push( move( split_data.front() ) );
+        string segment = bs.writer().chunk_pool().take( write_size );
+        segment.assign( split_data.front() );
+        bs.writer().push( move( segment ) );
         split_data.pop();
       }
     }
@@ -63,6 +80,7 @@ double speed_test( fstream& debug_output,
   }
 
   const auto stop_time = steady_clock::now();
+  const auto allocations = allocation_count() - start_allocations;
 
   if ( data != output_data ) {
     throw runtime_error( "Mismatch between data written and read" );
@@ -73,18 +91,29 @@ double speed_test( fstream& debug_output,
   auto bits_per_second = 8 * bytes_per_second;
   auto gigabits_per_second = bits_per_second / 1e9;
 
+  const auto segments = ( input_len + write_size - 1 ) / write_size;
+  const auto allocations_per_segment
+    = static_cast<double>( allocations.allocations ) / static_cast<double>( segments );
+
   cout << "ByteStream with capacity=" << capacity << ", write_size=" << write_size << ", read_size=" << read_size
-       << " reached " << fixed << setprecision( 2 ) << gigabits_per_second << " Gbit/s.\n";
+       << " reached " << fixed << setprecision( 2 ) << gigabits_per_second << " Gbit/s ("
+       << allocations.allocations << " heap allocations, " << allocations_per_segment << " per segment, "
+       << allocations.bytes << " bytes).\n";
 
   auto read_s = to_string( read_size );
   const string fill( 5 - read_s.size(), ' ' );
   debug_output << "        ByteStream throughput (pop length " << read_s << "):" << fill << fixed
-               << setprecision( 2 ) << setw( 5 ) << gigabits_per_second << " Gbit/s\n";
+               << setprecision( 2 ) << setw( 5 ) << gigabits_per_second << " Gbit/s, " << allocations_per_segment
+               << " allocations/segment\n";
 
   if ( gigabits_per_second < 0.1 ) {
     throw runtime_error( "ByteStream did not meet minimum speed of 0.1 Gbit/s" );
   }
 
+  if ( allocations.allocations > 0 ) {
+    throw runtime_error( "ByteStream allocated memory while pushing and popping (expected none)" );
+  }
+
   return gigabits_per_second;
 }
 
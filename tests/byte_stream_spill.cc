@@ -0,0 +1,134 @@
+#include "byte_stream.hh"
+#include "common.hh"
+#include "test_should_be.hh"
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+using namespace std;
+
+namespace {
+// The bytes at stream offsets [offset, offset + len): a pattern whose period (a prime) isn't a multiple of
+// the page size or the capacity, for `len` up to max_len
+constexpr uint64_t period = 1'000'003;
+constexpr uint64_t max_len = 1'000'000;
+
+string_view pattern_chunk( uint64_t offset, uint64_t len )
+{
+  static const string pattern = [] {
+    string ret( period + max_len, 0 );
+    for ( uint64_t i = 0; i < ret.size(); ++i ) {
+      ret[i] = static_cast<char>( ( ( i % period ) * 7 + ( i % period ) / 251 ) % 256 );
+    }
+    return ret;
+  }();
+  return string_view { pattern }.substr( offset % period, min( len, max_len ) );
+}
+
+// Resident memory of the mappings that overlap [begin, begin + len), in bytes
+uint64_t resident_bytes( const char* begin, uint64_t len )
+{
+  const auto first = reinterpret_cast<uintptr_t>( begin ); // NOLINT(*-reinterpret-cast)
+  const auto last = first + len;
+
+  ifstream smaps { "/proc/self/smaps" };
+  uint64_t total = 0;
+  bool overlaps = false;
+  string line;
+  while ( getline( smaps, line ) ) {
+    uintptr_t start {};
+    uintptr_t end {};
+    char dash {};
+    istringstream fields { line };
+    if ( fields >> hex >> start >> dash >> end and dash == '-' ) {
+      overlaps = start < last and end > first;
+    } else if ( overlaps and line.starts_with( "Rss:" ) ) {
+      uint64_t kilobytes {};
+      istringstream { line.substr( 4 ) } >> kilobytes;
+      total += kilobytes * 1024;
+    }
+  }
+  return total;
+}
+
+void small_streams_stay_in_memory()
+{
+  const ByteStream bs { 65536 };
+  check( not bs.spills_to_file(), "a small stream doesn't spill" );
+}
+
+// A string pushed into an empty spilling stream is copied into the ring (not kept as it is, outside the file)
+void pushed_strings_are_copied()
+{
+  ByteStream bs { ByteStream::kSpillCapacity };
+  string data { pattern_chunk( 0, 100'000 ) };
+  const char* original = data.data();
+  bs.writer().push( move( data ) );
+  check( bs.reader().peek().data() != original, "the pushed string wasn't adopted" );
+  check( bs.reader().peek() == pattern_chunk( 0, 100'000 ), "the pushed bytes are in the ring" );
+}
+
+// Fill a spilling stream, then stream several times its capacity through it while checking every byte
+void round_trip()
+{
+  constexpr uint64_t chunk_size = 100'000; // not a multiple of the page size
+  constexpr uint64_t capacity = ByteStream::kSpillCapacity;
+  constexpr uint64_t total = 3 * capacity;
+
+  ByteStream bs { capacity };
+  check( bs.spills_to_file(), "a large stream spills to a file" );
+
+  uint64_t pushed = 0;
+  while ( bs.writer().available_capacity() > 0 ) {
+    const auto len = min( chunk_size, bs.writer().available_capacity() );
+    bs.writer().push( string { pattern_chunk( pushed, len ) } );
+    pushed += len;
+  }
+  test_should_be( bs.reader().bytes_buffered(), capacity );
+  check( resident_bytes( bs.reader().peek().data(), 2 * capacity ) < capacity / 2,
+         "the middle of a full stream isn't resident" );
+
+  uint64_t popped = 0;
+  while ( popped < total ) {
+    const auto view = bs.reader().peek();
+    check( view.size() == bs.reader().bytes_buffered(), "peek() returns all buffered bytes" );
+    const auto read_len = min( chunk_size * 3 / 2, static_cast<uint64_t>( view.size() ) );
+    check( view.substr( 0, read_len ) == pattern_chunk( popped, read_len ),
+           "bytes read back from the file are intact" );
+    bs.reader().pop( read_len );
+    popped += read_len;
+
+    while ( pushed < total and bs.writer().available_capacity() >= chunk_size ) {
+      const auto len = min( chunk_size, total - pushed );
+      bs.writer().push( string { pattern_chunk( pushed, len ) } );
+      pushed += len;
+    }
+    if ( pushed >= total ) {
+      bs.writer().close();
+    }
+  }
+
+  check( bs.reader().is_finished(), "stream is finished" );
+  test_should_be( bs.reader().bytes_popped(), total );
+}
+} // namespace
+
+int main()
+{
+  try {
+    small_streams_stay_in_memory();
+    pushed_strings_are_copied();
+    round_trip();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,141 @@
+#include "common.hh"
+#include "spsc_byte_stream.hh"
+#include "test_should_be.hh"
+
+#include <iostream>
+#include <poll.h>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+namespace {
+bool is_signaled( FileDescriptor& event )
+{
+  pollfd pfd { event.fd_num(), POLLIN, 0 };
+  return ::poll( &pfd, 1, 0 ) == 1;
+}
+
+void wait_for( FileDescriptor& event )
+{
+  pollfd pfd { event.fd_num(), POLLIN, 0 };
+  while ( ::poll( &pfd, 1, 1000 ) != 1 ) {}
+}
+
+void single_thread_basics()
+{
+  SPSCByteStream bs { 10 };
+  test_should_be( bs.writer().push( "hello" ), uint64_t { 5 } );
+  test_should_be( bs.writer().push( "world!" ), uint64_t { 5 } );
+  test_should_be( bs.writer().available_capacity(), uint64_t { 0 } );
+  test_should_be( bs.reader().bytes_buffered(), uint64_t { 10 } );
+  check( bs.reader().peek() == "helloworld", "peek() returns all buffered bytes" );
+
+  bs.reader().pop( 7 );
+  test_should_be( bs.reader().bytes_popped(), uint64_t { 7 } );
+  test_should_be( bs.writer().push( "abcdefgh" ), uint64_t { 7 } );
+  test_should_be( bs.reader().bytes_buffered(), uint64_t { 10 } );
+  check( bs.reader().peek() == "rldabcdefg", "peek() returns all buffered bytes" );
+
+  bs.reader().pop( 3 );
+  bs.writer().push( "xyz" );
+  check( bs.reader().peek() == "abcdefg", "peek() may return only the bytes it already knew about" );
+
+  bs.writer().close();
+  check( bs.writer().is_closed(), "writer is closed" );
+  check( not bs.reader().is_finished(), "reader is not finished with bytes buffered" );
+  bs.reader().pop( 7 );
+  check( bs.reader().peek() == "xyz", "peek() catches up once the known bytes are popped" );
+  bs.reader().pop( 3 );
+  check( bs.reader().is_finished(), "reader is finished" );
+  test_should_be( bs.writer().bytes_pushed(), uint64_t { 20 } );
+}
+
+void events()
+{
+  SPSCByteStream bs { 4, true };
+  check( not is_signaled( bs.reader().readable_event() ), "empty stream is not readable" );
+  check( is_signaled( bs.writer().writable_event() ), "empty stream is writable" );
+
+  bs.writer().push( "ab" );
+  check( is_signaled( bs.reader().readable_event() ), "push makes stream readable" );
+  bs.reader().acknowledge_event();
+  check( is_signaled( bs.reader().readable_event() ), "acknowledge leaves event set while bytes remain" );
+
+  bs.writer().push( "cdef" );
+  bs.writer().acknowledge_event();
+  check( not is_signaled( bs.writer().writable_event() ), "full stream is not writable after acknowledge" );
+
+  bs.reader().pop( 1 );
+  check( is_signaled( bs.writer().writable_event() ), "pop from full stream makes it writable" );
+
+  bs.reader().pop( 3 );
+  bs.reader().acknowledge_event();
+  check( not is_signaled( bs.reader().readable_event() ), "drained stream is not readable after acknowledge" );
+
+  bs.writer().close();
+  check( is_signaled( bs.reader().readable_event() ), "close makes stream readable" );
+  bs.reader().acknowledge_event();
+  check( is_signaled( bs.reader().readable_event() ), "closed stream stays readable" );
+}
+
+void two_threads( size_t input_len, size_t capacity, size_t random_seed )
+{
+  string data;
+  default_random_engine rd { random_seed };
+  uniform_int_distribution<char> ud;
+  for ( size_t i = 0; i < input_len; ++i ) {
+    data += ud( rd );
+  }
+
+  SPSCByteStream bs { capacity, true };
+
+  thread producer { [&] {
+    default_random_engine prd { random_seed + 1 };
+    uniform_int_distribution<size_t> chunk_size { 1, 3000 };
+    size_t offset = 0;
+    while ( offset < data.size() ) {
+      offset += bs.writer().push( string_view { data }.substr( offset, chunk_size( prd ) ) );
+      bs.writer().acknowledge_event();
+      if ( bs.writer().available_capacity() == 0 ) {
+        wait_for( bs.writer().writable_event() );
+      }
+    }
+    bs.writer().close();
+  } };
+
+  string output;
+  output.reserve( data.size() );
+  uniform_int_distribution<size_t> read_size { 1, 5000 };
+  while ( not bs.reader().is_finished() ) {
+    const auto view = bs.reader().peek().substr( 0, read_size( rd ) );
+    output += view;
+    bs.reader().pop( view.size() );
+    bs.reader().acknowledge_event();
+    if ( bs.reader().bytes_buffered() == 0 and not bs.reader().is_finished() ) {
+      wait_for( bs.reader().readable_event() );
+    }
+  }
+  producer.join();
+
+  test_should_be( output.size(), data.size() );
+  check( output == data, "consumer read the same bytes the producer wrote" );
+}
+} // namespace
+
+int main()
+{
+  try {
+    single_thread_basics();
+    events();
+    two_threads( 1'000'000, 4096, 1234 );
+    two_threads( 1'000'000, 65536, 4321 );
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
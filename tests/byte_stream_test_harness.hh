@@ -4,6 +4,7 @@
 #include "common.hh"
 #include "helpers.hh"
 
+#include <array>
 #include <utility>
 
 static_assert( sizeof( Reader ) == sizeof( ByteStream ),
@@ -119,6 +120,33 @@ struct PeekOnce : public Peek
   }
 };
 
+struct PeekIov : public Peek
+{
+  using Peek::Peek;
+
+  std::string description() const override
+  {
+    return "peek_iov() views concatenate to \"" + pretty_print( output_ ) + "\"";
+  }
+
+  void execute( const ByteStream& bs ) const override
+  {
+    std::array<std::string_view, 4> views {};
+    const size_t count = bs.reader().peek_iov( views );
+    std::string got;
+    for ( size_t i = 0; i < count; ++i ) {
+      if ( views.at( i ).empty() ) {
+        throw ExpectationViolation { "peek_iov() method returned an empty view" };
+      }
+      got += views.at( i );
+    }
+    if ( got != output_ ) {
+      throw ExpectationViolation { "peek_iov() should have covered \"" + pretty_print( output_ )
+                                   + "\", but instead covered \"" + pretty_print( got ) + "\"" };
+    }
+  }
+};
+
 struct IsClosed : public ExpectBool<ByteStream>
 {
   using ExpectBool::ExpectBool;
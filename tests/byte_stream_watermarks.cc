@@ -0,0 +1,135 @@
+#include "byte_stream_test_harness.hh"
+
+#include <exception>
+#include <iostream>
+#include <memory>
+
+using namespace std;
+
+// Records every readiness notification, in order, as e.g. "reader ready" or "writer not ready".
+using NotificationLog = shared_ptr<vector<string>>;
+
+struct SetWatermarks : public Action<ByteStream>
+{
+  uint64_t low_;
+  uint64_t high_;
+  NotificationLog log_;
+
+  SetWatermarks( uint64_t low, uint64_t high, NotificationLog log )
+    : low_( low ), high_( high ), log_( move( log ) )
+  {}
+
+  std::string description() const override
+  {
+    return "set watermarks (low=" + to_string( low_ ) + ", high=" + to_string( high_ ) + ")";
+  }
+
+  void execute( ByteStream& bs ) const override
+  {
+    auto log = log_;
+    bs.set_reader_watermark( low_, [log]( bool ready ) {
+      log->push_back( ready ? "reader ready" : "reader not ready" );
+    } );
+    bs.set_writer_watermark( high_, [log]( bool ready ) {
+      log->push_back( ready ? "writer ready" : "writer not ready" );
+    } );
+  }
+};
+
+struct Notified : public Expectation<ByteStream>
+{
+  vector<string> expected_;
+  NotificationLog log_;
+
+  Notified( vector<string> expected, NotificationLog log ) : expected_( move( expected ) ), log_( move( log ) ) {}
+
+  std::string description() const override
+  {
+    string ret = "notifications were {";
+    for ( const auto& x : expected_ ) {
+      ret += " \"" + x + "\"";
+    }
+    return ret + " }";
+  }
+
+  void execute( const ByteStream& /* bs */ ) const override
+  {
+    if ( *log_ != expected_ ) {
+      string got;
+      for ( const auto& x : *log_ ) {
+        got += " \"" + x + "\"";
+      }
+      throw ExpectationViolation { "notifications were {" + got + " }" };
+    }
+    log_->clear();
+  }
+};
+
+int main()
+{
+  try {
+    {
+      ByteStreamTestHarness test { "callbacks fire only on crossings", 10 };
+      auto log = make_shared<vector<string>>();
+
+      test.execute( SetWatermarks { 0, 10, log } );
+      test.execute( Notified { { "reader not ready", "writer ready" }, log } );
+      test.execute( Push { "abc" } );
+      test.execute( Notified { { "reader ready" }, log } );
+      test.execute( Push { "def" } );
+      test.execute( Pop { 2 } );
+      test.execute( Notified { {}, log } );
+      test.execute( Push { "ghijkl" } );
+      test.execute( Notified { { "writer not ready" }, log } );
+      test.execute( Pop { 1 } );
+      test.execute( Notified { { "writer ready" }, log } );
+      test.execute( Pop { 9 } );
+      test.execute( Notified { { "reader not ready" }, log } );
+    }
+
+    {
+      ByteStreamTestHarness test { "watermarks in the middle", 10 };
+      auto log = make_shared<vector<string>>();
+
+      test.execute( Push { "abcd" } );
+      test.execute( SetWatermarks { 4, 6, log } );
+      test.execute( Notified { { "reader not ready", "writer ready" }, log } );
+      test.execute( Push { "e" } );
+      test.execute( Notified { { "reader ready" }, log } );
+      test.execute( Push { "f" } );
+      test.execute( Notified { { "writer not ready" }, log } );
+      test.execute( Pop { 1 } );
+      test.execute( Notified { { "writer ready" }, log } );
+      test.execute( Pop { 1 } );
+      test.execute( Notified { { "reader not ready" }, log } );
+    }
+
+    {
+      ByteStreamTestHarness test { "close and error", 10 };
+      auto log = make_shared<vector<string>>();
+
+      test.execute( SetWatermarks { 0, 10, log } );
+      test.execute( Notified { { "reader not ready", "writer ready" }, log } );
+      test.execute( Close {} );
+      test.execute( Notified { { "reader ready", "writer not ready" }, log } );
+      test.execute( SetError {} );
+      test.execute( Notified { {}, log } );
+    }
+
+    {
+      ByteStreamTestHarness test { "copies don't notify", 10 };
+      auto log = make_shared<vector<string>>();
+
+      test.execute( SetWatermarks { 0, 10, log } );
+      test.execute( Push { "hello" } );
+      test.execute( Notified { { "reader not ready", "writer ready", "reader ready" }, log } );
+      test.execute( Peek { "hello" } ); // pops from a copy of the stream
+      test.execute( Notified { {}, log } );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
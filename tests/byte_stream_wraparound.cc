@@ -0,0 +1,85 @@
+#include "byte_stream_test_harness.hh"
+
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+int main()
+{
+  try {
+    {
+      ByteStreamTestHarness test { "peek covers every buffered byte", 15 };
+
+      test.execute( Push { "cat" } );
+      test.execute( Push { "tac" } );
+      test.execute( Push { "dog" } );
+      test.execute( PeekOnce { "cattacdog" } );
+      test.execute( Pop { 4 } );
+      test.execute( PeekOnce { "acdog" } );
+      test.execute( Push { "0123456789" } );
+      test.execute( PeekOnce { "acdog0123456789" } );
+      test.execute( PeekIov { "acdog0123456789" } );
+      test.execute( AvailableCapacity { 0 } );
+    }
+
+    {
+      // Cycle enough data through a small stream that the ring storage wraps around many times,
+      // and check that peek() never splits the buffered bytes at the wraparound point.
+      ByteStreamTestHarness test { "peek stays contiguous across wraparound", 1000 };
+
+      string expected = string( 300, '-' );
+      uint64_t pushed = expected.size();
+      test.execute( Push { expected } );
+
+      for ( unsigned round = 0; round < 64; ++round ) {
+        string chunk;
+        for ( unsigned i = 0; i < 700; ++i ) {
+          chunk.push_back( static_cast<char>( 'a' + ( pushed + i ) % 26 ) );
+        }
+        pushed += chunk.size();
+        expected += chunk;
+
+        test.execute( Push { chunk } );
+        test.execute( BytesBuffered { expected.size() } );
+        test.execute( PeekOnce { expected } );
+
+        test.execute( Pop { 700 } );
+        expected.erase( 0, 700 );
+        test.execute( PeekOnce { expected } );
+        test.execute( PeekIov { expected } );
+      }
+
+      test.execute( BytesPushed { pushed } );
+      test.execute( Close {} );
+      test.execute( ReadAll { expected } );
+      test.execute( IsFinished { true } );
+    }
+
+    {
+      ByteStreamTestHarness test { "peek_iov on an empty stream", 15 };
+
+      test.execute( PeekIov { "" } );
+      test.execute( Push { "abc" } );
+      test.execute( Pop { 3 } );
+      test.execute( PeekIov { "" } );
+    }
+
+    {
+      ByteStreamTestHarness test { "copies are independent", 15 };
+
+      test.execute( Push { "hello" } );
+      test.execute( Peek { "hello" } ); // Peek works on a copy of the stream
+      test.execute( PeekOnce { "hello" } );
+      test.execute( Pop { 5 } );
+      test.execute( Push { "world" } );
+      test.execute( Peek { "world" } );
+      test.execute( BytesPopped { 5 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
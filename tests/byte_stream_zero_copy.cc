@@ -0,0 +1,102 @@
+#include "byte_stream_test_harness.hh"
+
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+// Push an owned string and check whether the stream kept the caller's buffer (no copy) or copied it.
+struct PushOwned : public Action<ByteStream>
+{
+  std::string data_;
+  bool expect_adopted_;
+
+  PushOwned( std::string data, bool expect_adopted ) : data_( move( data ) ), expect_adopted_( expect_adopted ) {}
+
+  std::string description() const override
+  {
+    return "push owned \"" + pretty_print( data_ ) + "\" (" + ( expect_adopted_ ? "not copied" : "copied" ) + ")";
+  }
+
+  void execute( ByteStream& bs ) const override
+  {
+    std::string data = data_;
+    const char* original = data.data();
+    bs.writer().push( Ref<std::string> { move( data ) } );
+
+    const bool adopted = bs.reader().peek().data() == original;
+    if ( adopted != expect_adopted_ ) {
+      throw ExpectationViolation { std::string { "push() should " } + ( expect_adopted_ ? "not " : "" )
+                                   + "have copied the pushed buffer" };
+    }
+  }
+
+  constexpr std::string obj() const override { return "Writer"; }
+};
+
+struct PushBorrowed : public Push
+{
+  using Push::Push;
+  std::string description() const override { return "push borrowed \"" + pretty_print( data_ ) + "\""; }
+  void execute( ByteStream& bs ) const override { bs.writer().push( borrow( data_ ) ); }
+};
+
+int main()
+{
+  try {
+    // (strings are longer than the small-string buffer, so that moving them keeps their heap storage)
+    const string abc = "abcdefghijklmnopqrstuvwxyz";
+    const string digits = "0123456789012345678901234567890123456789";
+
+    {
+      ByteStreamTestHarness test { "push into empty stream keeps the buffer", 100 };
+      test.execute( PushOwned { abc, true } );
+      test.execute( PeekOnce { abc } );
+      test.execute( BytesBuffered { abc.size() } );
+      test.execute( Pop { 10 } );
+      test.execute( PeekOnce { abc.substr( 10 ) } );
+      test.execute( ReadAll { abc.substr( 10 ) } );
+      test.execute( PushOwned { digits, true } );
+      test.execute( PeekOnce { digits } );
+    }
+
+    {
+      ByteStreamTestHarness test { "push behind buffered bytes copies both into the ring", 100 };
+      test.execute( PushOwned { abc, true } );
+      test.execute( Pop { 6 } );
+      test.execute( PushOwned { digits, false } );
+      test.execute( PeekOnce { abc.substr( 6 ) + digits } );
+      test.execute( BytesBuffered { abc.size() - 6 + digits.size() } );
+      test.execute( BytesPushed { abc.size() + digits.size() } );
+      test.execute( Pop { abc.size() - 6 } );
+      test.execute( PeekOnce { digits } );
+    }
+
+    {
+      ByteStreamTestHarness test { "truncated push still keeps the buffer", 20 };
+      test.execute( PushOwned { abc, true } );
+      test.execute( PeekOnce { abc.substr( 0, 20 ) } );
+      test.execute( AvailableCapacity { 0 } );
+      test.execute( BytesPushed { 20 } );
+      test.execute( Pop { 20 } );
+      test.execute( PushOwned { digits, true } );
+      test.execute( PeekOnce { digits.substr( 0, 20 ) } );
+    }
+
+    {
+      ByteStreamTestHarness test { "borrowed strings are copied", 100 };
+      test.execute( PushBorrowed { abc } );
+      test.execute( PeekOnce { abc } );
+      test.execute( PushBorrowed { digits } );
+      test.execute( PeekOnce { abc + digits } );
+      test.execute( Close {} );
+      test.execute( ReadAll { abc + digits } );
+      test.execute( IsFinished { true } );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
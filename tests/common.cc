@@ -80,6 +80,15 @@ string to_string( const TCPSenderMessage& msg )
   if ( msg.SYN ) {
     o << " +SYN";
   }
+  if ( msg.SACK_permitted ) {
+    o << " +SACK_PERMITTED";
+  }
+  if ( msg.window_scale.has_value() ) {
+    o << " +WSCALE=" << static_cast<int>( *msg.window_scale );
+  }
+  if ( msg.timestamp.has_value() ) {
+    o << " TS=" << *msg.timestamp;
+  }
   if ( not msg.payload.empty() ) {
     o << " payload=\"" << pretty_print( msg.payload ) << "\"";
   }
@@ -250,4 +250,13 @@ struct ExpectBool : public ExpectNumber<T, bool>
   using ExpectNumber<T, bool>::ExpectNumber;
 };
 
+// A check outside any harness, for a property of something no single harness steps through (a pair of
+// connected peers, a serialized segment)
+inline void check( bool condition, const std::string& description )
+{
+  if ( not condition ) {
+    throw ExpectationViolation( "expectation failed: " + description );
+  }
+}
+
 std::string to_string( const TCPSenderMessage& msg );
@@ -0,0 +1,200 @@
+#include "allocation_counter.hh"
+#include "reassembler.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+constexpr uint64_t capacity = 65536;
+constexpr uint64_t windows = 16;
+constexpr uint64_t stream_size = windows * capacity;
+
+// Segments to deliver for the window of the stream that begins at `window_begin`. Every byte of the window must
+// end up covered (segments may also reach past the window, to be truncated).
+using Segment = Reassembler::Segment;
+using WindowPlan = function<vector<Segment>( const string& data, uint64_t window_begin, default_random_engine& )>;
+
+Segment make_segment( const string& data, uint64_t first_index, uint64_t len )
+{
+  first_index = min( first_index, data.size() );
+  len = min( len, data.size() - first_index );
+  return { first_index, data.substr( first_index, len ), first_index + len == data.size() };
+}
+
+// The window in segments of `segment_size`, last one first
+vector<Segment> reverse_order( const string& data, uint64_t window_begin, uint64_t segment_size )
+{
+  vector<Segment> ret;
+  for ( uint64_t i = capacity; i > 0; i -= min( i, segment_size ) ) {
+    const uint64_t len = min( i, segment_size );
+    ret.push_back( make_segment( data, window_begin + i - len, len ) );
+  }
+  return ret;
+}
+
+// A one-byte hole every `n` bytes, and then the holes filled in, last one first
+vector<Segment> holes_every( const string& data, uint64_t window_begin, uint64_t n )
+{
+  vector<Segment> ret;
+  for ( uint64_t i = 0; i < capacity; i += n ) {
+    ret.push_back( make_segment( data, window_begin + i + 1, min( n, capacity - i ) - 1 ) );
+  }
+  for ( uint64_t i = ( capacity - 1 ) / n * n + n; i > 0; i -= n ) {
+    ret.push_back( make_segment( data, window_begin + i - n, 1 ) );
+  }
+  return ret;
+}
+
+struct Result
+{
+  double gigabits_per_second {};
+  double nanoseconds_per_segment {};
+};
+
+Result run( string_view scenario, Reassembler::Engine engine, const WindowPlan& plan )
+{
+  default_random_engine rd { 20241 };
+  uniform_int_distribution<char> ud;
+  string data( stream_size, 0 );
+  generate( data.begin(), data.end(), [&] { return ud( rd ); } );
+
+  vector<vector<Segment>> deliveries;
+  uint64_t segments = 0;
+  uint64_t bytes_inserted = 0;
+  for ( uint64_t w = 0; w < stream_size; w += capacity ) {
+    deliveries.push_back( plan( data, w, rd ) );
+    segments += deliveries.back().size();
+    for ( const auto& segment : deliveries.back() ) {
+      bytes_inserted += segment.data.size();
+    }
+  }
+
+  Reassembler reassembler { ByteStream { capacity }, engine };
+  string output_data;
+  output_data.reserve( data.size() );
+  uint64_t peak_pending = 0;
+
+  const auto start_allocations = allocation_count();
+  const auto start_time = steady_clock::now();
+  for ( auto& window : deliveries ) {
+    for ( auto& [first_index, segment_data, is_last] : window ) {
+      reassembler.insert( first_index, move( segment_data ), is_last );
+      peak_pending = max( peak_pending, reassembler.count_bytes_pending() );
+
+      while ( reassembler.reader().bytes_buffered() ) {
+        output_data += reassembler.reader().peek();
+        reassembler.reader().pop( output_data.size() - reassembler.reader().bytes_popped() );
+      }
+    }
+  }
+  const auto stop_time = steady_clock::now();
+  const auto allocations = allocation_count() - start_allocations;
+
+  if ( not reassembler.reader().is_finished() ) {
+    throw runtime_error( string( scenario ) + ": Reassembler did not close ByteStream when finished" );
+  }
+  if ( data != output_data ) {
+    throw runtime_error( string( scenario ) + ": Mismatch between data written and read" );
+  }
+
+  const auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+  const Result result { 8 * static_cast<double>( stream_size ) / test_duration.count() / 1e9,
+                        1e9 * test_duration.count() / static_cast<double>( segments ) };
+  const auto allocations_per_byte
+    = static_cast<double>( allocations.allocations ) / static_cast<double>( bytes_inserted );
+
+  cout << "Reassembler (" << ( engine == Reassembler::Engine::Bitmap ? "bitmap" : "fragments" ) << ", "
+       << scenario << ") reached " << fixed << setprecision( 2 ) << result.gigabits_per_second << " Gbit/s ("
+       << segments << " segments, peak " << peak_pending << " bytes pending, " << setprecision( 4 )
+       << allocations_per_byte << " allocations per inserted byte).\n";
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+  debug_output << "        Reassembler " << ( engine == Reassembler::Engine::Bitmap ? "bitmap    " : "fragments " )
+               << left << setw( 28 ) << scenario << right << fixed << setprecision( 2 ) << setw( 6 )
+               << result.gigabits_per_second << " Gbit/s, peak " << setw( 5 ) << peak_pending << " pending, "
+               << setprecision( 4 ) << allocations_per_byte << " allocations/byte\n";
+
+  // The fragments engine's speed is only reported: on the hole-riddled windows it is near the floor, and would fail
+  // it on a loaded machine. (The complexity guard below still covers it.)
+  if ( engine == Reassembler::Engine::Bitmap and result.gigabits_per_second < 0.05 ) {
+    throw runtime_error( string( scenario ) + ": Reassembler did not meet minimum speed of 0.05 Gbit/s." );
+  }
+
+  return result;
+}
+
+void program_body()
+{
+  for ( const auto engine : { Reassembler::Engine::Fragments, Reassembler::Engine::Bitmap } ) {
+    run( "reverse order", engine, []( const string& data, uint64_t w, auto& ) {
+      return reverse_order( data, w, 1000 );
+    } );
+
+    run( "fully duplicated", engine, []( const string& data, uint64_t w, auto& ) {
+      vector<Segment> ret;
+      for ( auto& segment : reverse_order( data, w, 1000 ) ) {
+        ret.push_back( segment );
+        ret.push_back( move( segment ) );
+      }
+      return ret;
+    } );
+
+    run( "random overlap", engine, []( const string& data, uint64_t w, default_random_engine& rd ) {
+      vector<Segment> ret;
+      uniform_int_distribution<uint64_t> offset { 0, capacity - 1 };
+      uniform_int_distribution<uint64_t> length { 1, 2000 };
+      for ( size_t i = 0; i < 150; ++i ) {
+        ret.push_back( make_segment( data, w + offset( rd ), length( rd ) ) );
+      }
+      auto cover = reverse_order( data, w, 1500 );
+      move( cover.begin(), cover.end(), back_inserter( ret ) );
+      return ret;
+    } );
+
+    run( "window-edge truncation", engine, []( const string& data, uint64_t w, auto& ) {
+      vector<Segment> ret;
+      for ( uint64_t i = capacity; i > 0; i -= min( i, uint64_t { 1000 } ) ) {
+        ret.push_back( make_segment( data, w + i - min( i, uint64_t { 1000 } ), capacity ) );
+      }
+      return ret;
+    } );
+
+    // Complexity guard: eight times as many holes must not make each segment much more expensive to insert.
+    const auto few = run( "one-byte holes every 64", engine, []( const string& data, uint64_t w, auto& ) {
+      return holes_every( data, w, 64 );
+    } );
+    const auto many = run( "one-byte holes every 8", engine, []( const string& data, uint64_t w, auto& ) {
+      return holes_every( data, w, 8 );
+    } );
+    const double slowdown = many.nanoseconds_per_segment / few.nanoseconds_per_segment;
+    if ( slowdown > 4 ) {
+      throw runtime_error( "Reassembler insertion cost grew " + to_string( slowdown )
+                           + "x per segment with 8x as many holes (super-linear in the number of holes)" );
+    }
+  }
+}
+} // namespace
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
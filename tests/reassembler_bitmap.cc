@@ -0,0 +1,143 @@
+#include "byte_stream_test_harness.hh"
+#include "random.hh"
+#include "reassembler_test_harness.hh"
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+namespace {
+constexpr auto bitmap = Reassembler::Engine::Bitmap;
+
+// Feed the same random, overlapping, reordered segments to both engines (reading from the outputs as it goes,
+// so the window wraps around the ring several times) and check that they agree after every insertion.
+void compare_engines( size_t rep_no )
+{
+  auto rd = get_random_engine();
+  constexpr uint64_t capacity = 5000;
+  constexpr size_t total = 60000;
+
+  string d( total, 0 );
+  generate( d.begin(), d.end(), [&] { return rd(); } );
+
+  Reassembler fragments { ByteStream { capacity } };
+  Reassembler in_place { ByteStream { capacity }, bitmap };
+  string fragments_out;
+  string in_place_out;
+  string chunk;
+
+  const auto fail = [&]( const string& what ) {
+    throw runtime_error( "engines disagree (rep " + to_string( rep_no ) + "): " + what );
+  };
+
+  while ( fragments.writer().bytes_pushed() < total ) {
+    const uint64_t next = fragments.writer().bytes_pushed();
+    const uint64_t first = next - min( next, rd() % 200 ) + rd() % ( capacity + 200 );
+    const uint64_t len = min( total - min( total, first ), 1 + rd() % 600 );
+    const bool last = first + len == total;
+
+    fragments.insert( first, d.substr( min<uint64_t>( first, total ), len ), last );
+    in_place.insert( first, d.substr( min<uint64_t>( first, total ), len ), last );
+
+    if ( fragments.count_bytes_pending() != in_place.count_bytes_pending() ) {
+      fail( "bytes pending " + to_string( fragments.count_bytes_pending() ) + " vs "
+            + to_string( in_place.count_bytes_pending() ) );
+    }
+    if ( fragments.writer().bytes_pushed() != in_place.writer().bytes_pushed() ) {
+      fail( "bytes pushed" );
+    }
+
+    if ( rd() % 3 == 0 ) {
+      const uint64_t read_len = rd() % 3000;
+      read( fragments.reader(), read_len, chunk );
+      fragments_out += chunk;
+      read( in_place.reader(), read_len, chunk );
+      in_place_out += chunk;
+    }
+  }
+
+  read( fragments.reader(), total, chunk );
+  fragments_out += chunk;
+  read( in_place.reader(), total, chunk );
+  in_place_out += chunk;
+  if ( in_place_out != fragments_out or in_place_out != d ) {
+    fail( "output" );
+  }
+  if ( not in_place.reader().is_finished() ) {
+    fail( "stream not finished" );
+  }
+}
+} // namespace
+
+int main()
+{
+  try {
+    {
+      ReassemblerTestHarness test { "bitmap holes", 8, bitmap };
+
+      test.execute( Insert { "d", 3 } );
+      test.execute( BytesPending( 1 ) );
+      test.execute( Insert { "bc", 1 } );
+      test.execute( BytesPending( 3 ) );
+      test.execute( BytesPushed( 0 ) );
+
+      test.execute( Insert { "a", 0 } );
+      test.execute( BytesPending( 0 ) );
+      test.execute( BytesPushed( 4 ) );
+      test.execute( ReadAll( "abcd" ) );
+    }
+
+    {
+      ReassemblerTestHarness test { "bitmap overlaps and duplicates", 8, bitmap };
+
+      test.execute( Insert { "cde", 2 } );
+      test.execute( Insert { "cd", 2 } );
+      test.execute( Insert { "def", 3 } );
+      test.execute( BytesPending( 4 ) );
+
+      test.execute( Insert { "abc", 0 } );
+      test.execute( BytesPending( 0 ) );
+      test.execute( ReadAll( "abcdef" ) );
+    }
+
+    {
+      ReassemblerTestHarness test { "bitmap window edge and wraparound", 4, bitmap };
+
+      test.execute( Insert { "bcdef", 1 } );
+      test.execute( BytesPending( 3 ) );
+      test.execute( Insert { "a", 0 } );
+      test.execute( BytesPushed( 4 ) );
+      test.execute( ReadAll( "abcd" ) );
+
+      test.execute( Insert { "ghij", 6 } );
+      test.execute( BytesPending( 2 ) );
+      test.execute( Insert { "ef", 4 } );
+      test.execute( ReadAll( "efgh" ) );
+      test.execute( BytesPending( 0 ) );
+    }
+
+    {
+      ReassemblerTestHarness test { "bitmap last substring", 8, bitmap };
+
+      test.execute( Insert { "", 4 }.is_last() );
+      test.execute( IsFinished { false } );
+      test.execute( Insert { "cd", 2 } );
+      test.execute( IsFinished { false } );
+      test.execute( Insert { "ab", 0 } );
+      test.execute( ReadAll( "abcd" ) );
+      test.execute( IsFinished { true } );
+    }
+
+    for ( size_t rep_no = 0; rep_no < 8; ++rep_no ) {
+      compare_engines( rep_no );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
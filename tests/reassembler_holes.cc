@@ -130,6 +130,40 @@ int main()
       test.execute( ReadAll( "" ) );
       test.execute( IsFinished { true } );
     }
+
+    {
+      ReassemblerTestHarness test { "holes 8 (reverse order)", 65000 };
+
+      for ( uint64_t i = 9; i > 0; --i ) {
+        test.execute( Insert { string( 1, static_cast<char>( 'a' + i ) ), i } );
+        test.execute( BytesPending( 10 - i ) );
+      }
+      test.execute( BytesPushed( 0 ) );
+
+      test.execute( Insert { "a", 0 } );
+      test.execute( BytesPending( 0 ) );
+      test.execute( ReadAll( "abcdefghij" ) );
+    }
+
+    {
+      ReassemblerTestHarness test { "holes 9 (spanning several fragments)", 65000 };
+
+      test.execute( Insert { "b", 1 } );
+      test.execute( Insert { "d", 3 } );
+      test.execute( Insert { "fgh", 5 } );
+      test.execute( BytesPending( 5 ) );
+
+      test.execute( Insert { "bcdefg", 1 } );
+      test.execute( BytesPending( 7 ) );
+      test.execute( BytesPushed( 0 ) );
+
+      test.execute( Insert { "hij", 7 } );
+      test.execute( BytesPending( 9 ) );
+
+      test.execute( Insert { "a", 0 } );
+      test.execute( BytesPending( 0 ) );
+      test.execute( ReadAll( "abcdefghij" ) );
+    }
   } catch ( const exception& e ) {
     cerr << "Exception: " << e.what() << "\n";
     return EXIT_FAILURE;
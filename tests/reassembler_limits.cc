@@ -0,0 +1,132 @@
+#include "byte_stream_test_harness.hh"
+#include "reassembler_test_harness.hh"
+
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+namespace {
+constexpr auto fragments = Reassembler::Engine::Fragments;
+
+// A sender that keeps retransmitting everything it hasn't seen acknowledged, odd bytes last one first: with the
+// number of fragments capped, the receiver never holds more than the cap, and the stream still comes out whole.
+void retransmit_until_done()
+{
+  constexpr uint64_t total = 4000;
+  constexpr size_t cap = 100;
+  string d( total, 0 );
+  for ( uint64_t i = 0; i < total; ++i ) {
+    d[i] = static_cast<char>( 'a' + i % 26 );
+  }
+
+  Reassembler r { ByteStream { total }, fragments, { .max_fragments = cap } };
+  for ( size_t round = 0; r.writer().bytes_pushed() < total; ++round ) {
+    if ( round > total ) {
+      throw runtime_error( "stream never completed" );
+    }
+    for ( uint64_t end = total; end > r.writer().bytes_pushed() + 1; end -= 2 ) {
+      r.insert( end - 1, d.substr( end - 1, 1 ), end == total );
+      if ( r.count_fragments() > cap ) {
+        throw runtime_error( "stored " + to_string( r.count_fragments() ) + " fragments" );
+      }
+    }
+    for ( uint64_t i = r.writer().bytes_pushed(); i < total; i += 2 ) {
+      r.insert( i, d.substr( i, 1 ), i == total - 1 );
+    }
+  }
+
+  string out;
+  read( r.reader(), total, out );
+  if ( out != d or not r.reader().is_finished() ) {
+    throw runtime_error( "output doesn't match input" );
+  }
+  if ( r.evictions().fragments == 0 or r.evictions().triggered == 0 ) {
+    throw runtime_error( "eviction counters didn't advance" );
+  }
+}
+} // namespace
+
+int main()
+{
+  try {
+    {
+      ReassemblerTestHarness test { "fragment cap drops the furthest", 65000, fragments, { .max_fragments = 2 } };
+
+      test.execute( Insert { "d", 3 } );
+      test.execute( Insert { "f", 5 } );
+      test.execute( Insert { "b", 1 } );
+      test.execute( FragmentsStored( 2 ) );
+      test.execute( FragmentsEvicted( 1 ) );
+      test.execute( BytesPending( 2 ) );
+
+      test.execute( Insert { "a", 0 } );
+      test.execute( Insert { "c", 2 } );
+      test.execute( ReadAll( "abcd" ) );
+      test.execute( BytesPending( 0 ) );
+      test.execute( FragmentsStored( 0 ) );
+
+      test.execute( Insert { "ef", 4 } );
+      test.execute( ReadAll( "ef" ) );
+    }
+
+    {
+      ReassemblerTestHarness test { "touching fragments count once", 65000, fragments, { .max_fragments = 1 } };
+
+      test.execute( Insert { "b", 1 } );
+      test.execute( Insert { "c", 2 } );
+      test.execute( Insert { "d", 3 } );
+      test.execute( FragmentsStored( 1 ) );
+      test.execute( FragmentsEvicted( 0 ) );
+      test.execute( BytesPending( 3 ) );
+      test.execute( Insert { "a", 0 } );
+      test.execute( ReadAll( "abcd" ) );
+    }
+
+    {
+      ReassemblerTestHarness test { "evicted last substring", 65000, fragments, { .max_fragments = 1 } };
+
+      test.execute( Insert { "c", 2 }.is_last() );
+      test.execute( Insert { "a", 1 } );
+      test.execute( FragmentsEvicted( 1 ) );
+      test.execute( Insert { "x", 0 } );
+      test.execute( ReadAll( "xa" ) );
+      test.execute( IsFinished { false } );
+
+      test.execute( Insert { "c", 2 }.is_last() );
+      test.execute( ReadAll( "c" ) );
+      test.execute( IsFinished { true } );
+    }
+
+    {
+      const uint64_t one_byte = Reassembler::kFragmentOverhead + string {}.capacity() - 1;
+      ReassemblerTestHarness test {
+        "overhead cap", 65000, fragments, { .max_overhead_bytes = 2 * one_byte } };
+
+      test.execute( Insert { "b", 10 } );
+      test.execute( Insert { "c", 20 } );
+      test.execute( FragmentsEvicted( 0 ) );
+      test.execute( Insert { "a", 5 } );
+      test.execute( FragmentsStored( 2 ) );
+      test.execute( FragmentsEvicted( 1 ) );
+      test.execute( BytesPending( 2 ) );
+    }
+
+    {
+      ReassemblerTestHarness test { "bitmap engine ignores the caps", 65000, Reassembler::Engine::Bitmap,
+                                    { .max_fragments = 0 } };
+
+      test.execute( Insert { "b", 1 } );
+      test.execute( Insert { "d", 3 } );
+      test.execute( BytesPending( 2 ) );
+      test.execute( FragmentsEvicted( 0 ) );
+    }
+
+    retransmit_until_done();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,106 @@
+#include "byte_stream_test_harness.hh"
+#include "random.hh"
+#include "reassembler_test_harness.hh"
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+namespace {
+constexpr Reassembler::Engine engines[] { Reassembler::Engine::Fragments, Reassembler::Engine::Bitmap };
+
+// Deliver the same random segments in random-sized batches to one Reassembler, and one at a time to another,
+// and check that they agree after every batch.
+void compare_with_single_inserts( Reassembler::Engine engine )
+{
+  auto rd = get_random_engine();
+  constexpr uint64_t capacity = 4000;
+  constexpr size_t total = 50000;
+
+  string d( total, 0 );
+  generate( d.begin(), d.end(), [&] { return rd(); } );
+
+  Reassembler batched { ByteStream { capacity }, engine };
+  Reassembler single { ByteStream { capacity }, engine };
+  string batched_out;
+  string single_out;
+  string chunk;
+
+  while ( not batched.reader().is_finished() ) {
+    vector<Reassembler::Segment> batch( 1 + rd() % 64 );
+    for ( auto& [first_index, data, is_last_substring] : batch ) {
+      const uint64_t next = batched.writer().bytes_pushed();
+      first_index = min<uint64_t>( total, next - min<uint64_t>( next, rd() % 300 ) + rd() % capacity );
+      data = d.substr( first_index, 1 + rd() % 500 );
+      is_last_substring = first_index + data.size() == total;
+      single.insert( first_index, data, is_last_substring );
+    }
+    batched.insert_many( batch );
+
+    if ( batched.writer().bytes_pushed() != single.writer().bytes_pushed()
+         or batched.count_bytes_pending() != single.count_bytes_pending()
+         or batched.writer().is_closed() != single.writer().is_closed() ) {
+      throw runtime_error( "insert_many() disagrees with insert()" );
+    }
+
+    read( batched.reader(), rd() % 4000, chunk );
+    batched_out += chunk;
+    read( single.reader(), chunk.size(), chunk );
+    single_out += chunk;
+  }
+
+  if ( batched_out != d or single_out != d ) {
+    throw runtime_error( "insert_many() corrupted the stream" );
+  }
+}
+} // namespace
+
+int main()
+{
+  try {
+    for ( const auto engine : engines ) {
+      {
+        ReassemblerTestHarness test { "batch fills holes", 65000, engine };
+
+        test.execute( Insert { "e", 4 } );
+        test.execute( InsertMany { { { 2, "c", false }, { 0, "ab", false }, { 3, "d", false } } } );
+        test.execute( BytesPushed( 5 ) );
+        test.execute( BytesPending( 0 ) );
+        test.execute( ReadAll( "abcde" ) );
+      }
+
+      {
+        ReassemblerTestHarness test { "batch with overlaps and a gap", 65000, engine };
+
+        test.execute( InsertMany { { { 5, "fgh", false }, { 1, "bcd", false }, { 0, "abc", false } } } );
+        test.execute( BytesPushed( 4 ) );
+        test.execute( BytesPending( 3 ) );
+        test.execute( ReadAll( "abcd" ) );
+
+        test.execute( InsertMany { { { 8, "", true }, { 4, "ef", false } } } );
+        test.execute( ReadAll( "efgh" ) );
+        test.execute( IsFinished { true } );
+      }
+
+      {
+        ReassemblerTestHarness test { "batch beyond the window", 4, engine };
+
+        test.execute( InsertMany { { { 3, "defg", false }, { 0, "abc", false }, { 6, "g", true } } } );
+        test.execute( BytesPushed( 4 ) );
+        test.execute( BytesPending( 0 ) );
+        test.execute( ReadAll( "abcd" ) );
+        test.execute( IsFinished { false } );
+      }
+
+      compare_with_single_inserts( engine );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
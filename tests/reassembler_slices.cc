@@ -0,0 +1,86 @@
+#include "byte_stream_test_harness.hh"
+#include "reassembler_test_harness.hh"
+
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+namespace {
+string pattern( uint64_t first_index, uint64_t len )
+{
+  string ret( len, 0 );
+  for ( uint64_t i = 0; i < len; ++i ) {
+    ret[i] = static_cast<char>( 'a' + ( first_index + i ) % 26 );
+  }
+  return ret;
+}
+
+// Bytes that reach an empty output stream are read from the very buffer they arrived in, whether they were
+// written at once or stored first, and even if their first bytes had already been written.
+void zero_copy()
+{
+  Reassembler r { ByteStream { 4000 } };
+  r.insert( 0, pattern( 0, 2 ), false );
+  r.reader().pop( 2 );
+
+  string retransmitted = pattern( 0, 1000 );
+  const char* const retransmitted_bytes = retransmitted.data();
+  r.insert( 0, move( retransmitted ), false );
+  check( r.reader().peek().data() == retransmitted_bytes + 2, "retransmission is read in place" );
+  check( r.reader().peek() == pattern( 2, 998 ), "retransmission is read correctly" );
+  r.reader().pop( 998 );
+
+  r.insert( 1500, pattern( 1500, 500 ), false );
+  string filler = pattern( 1000, 1000 );
+  const char* const filler_bytes = filler.data();
+  r.insert( 1000, move( filler ), false );
+  check( r.count_fragments() == 0, "new bytes supersede the fragment within them" );
+  check( r.reader().peek().data() == filler_bytes, "stored bytes are read in place" );
+  check( r.reader().peek() == pattern( 1000, 1000 ), "stored bytes are read correctly" );
+}
+} // namespace
+
+int main()
+{
+  try {
+    {
+      ReassemblerTestHarness test { "overlapping slices", 65000 };
+
+      test.execute( Insert { pattern( 4, 3 ), 4 } );
+      test.execute( Insert { pattern( 5, 600 ), 5 } ); // its first two bytes are already stored
+      test.execute( FragmentsStored( 2 ) );
+      test.execute( BytesPending( 601 ) );
+
+      test.execute( Insert { pattern( 600, 10 ), 600 } ); // straddles the end (and its new bytes coalesce)
+      test.execute( Insert { pattern( 300, 20 ), 300 } ); // within
+      test.execute( FragmentsStored( 2 ) );
+      test.execute( BytesPending( 606 ) );
+
+      test.execute( Insert { pattern( 0, 4 ), 0 } );
+      test.execute( BytesPending( 0 ) );
+      test.execute( ReadAll( pattern( 0, 610 ) ) );
+    }
+
+    {
+      ReassemblerTestHarness test { "short slices coalesce", 65000 };
+
+      test.execute( Insert { pattern( 1, 300 ), 1 } );
+      test.execute( Insert { pattern( 301, 10 ), 301 } );
+      test.execute( Insert { pattern( 311, 256 ), 311 } );
+      test.execute( Insert { pattern( 567, 257 ), 567 } );
+      test.execute( FragmentsStored( 2 ) );
+      test.execute( BytesPending( 823 ) );
+
+      test.execute( Insert { pattern( 0, 1 ), 0 } );
+      test.execute( ReadAll( pattern( 0, 824 ) ) );
+    }
+
+    zero_copy();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -1,3 +1,4 @@
+#include "allocation_counter.hh"
 #include "reassembler.hh"
 
 #include <chrono>
@@ -17,7 +18,8 @@ void speed_test( const size_t num_chunks,  // NOLINT(bugprone-easily-swappable-p
                  const size_t overlap,     // NOLINT(bugprone-easily-swappable-parameters)
                  const size_t capacity,    // NOLINT(bugprone-easily-swappable-parameters)
                  const size_t random_seed, // NOLINT(bugprone-easily-swappable-parameters)
-                 string_view scenario )
+                 string_view scenario,
+                 Reassembler::Engine engine = Reassembler::Engine::Fragments )
 {
   // Generate the data to be written
   const string data = [&] {
@@ -46,11 +48,13 @@ void speed_test( const size_t num_chunks,  // NOLINT(bugprone-easily-swappable-p
     }
   }
 
-  Reassembler reassembler { ByteStream { capacity } };
+  Reassembler reassembler { ByteStream { capacity }, engine };
 
   string output_data;
   output_data.reserve( data.size() );
 
+  const auto segments = split_data.size();
+  const auto start_allocations = allocation_count();
   const auto start_time = steady_clock::now();
   while ( not split_data.empty() ) {
     auto& next = split_data.front();
@@ -64,6 +68,7 @@ void speed_test( const size_t num_chunks,  // NOLINT(bugprone-easily-swappable-p
   }
 
   const auto stop_time = steady_clock::now();
+  const auto allocations = allocation_count() - start_allocations;
 
   if ( not reassembler.reader().is_finished() ) {
     throw runtime_error( "Reassembler did not close ByteStream when finished" );
@@ -81,11 +86,16 @@ void speed_test( const size_t num_chunks,  // NOLINT(bugprone-easily-swappable-p
   fstream debug_output;
   debug_output.open( "/dev/tty" );
 
-  cout << "Reassembler to ByteStream with capacity=" << capacity << " reached " << fixed << setprecision( 2 )
-       << gigabits_per_second << " Gbit/s.\n";
+  const auto allocations_per_segment
+    = static_cast<double>( allocations.allocations ) / static_cast<double>( segments );
+
+  cout << "Reassembler" << ( engine == Reassembler::Engine::Bitmap ? " (bitmap engine)" : "" )
+       << " to ByteStream with capacity=" << capacity << " reached " << fixed << setprecision( 2 )
+       << gigabits_per_second << " Gbit/s (" << allocations.allocations << " heap allocations, "
+       << allocations_per_segment << " per segment, " << allocations.bytes << " bytes).\n";
 
   debug_output << "        Reassembler throughput " << scenario << fixed << setprecision( 2 ) << setw( 5 )
-               << gigabits_per_second << " Gbit/s\n";
+               << gigabits_per_second << " Gbit/s, " << allocations_per_segment << " allocations/segment\n";
 
   if ( gigabits_per_second < 0.1 ) {
     throw runtime_error( "Reassembler did not meet minimum speed of 0.1 Gbit/s." );
@@ -96,6 +106,8 @@ void program_body()
 {
   speed_test( 1000, 1500, 1500, 32768, 1370, "(no overlap):  " );
   speed_test( 1000, 1500, 150, 32768, 6163, "(10x overlap): " );
+  speed_test( 1000, 1500, 1500, 32768, 1370, "(no overlap, bitmap):  ", Reassembler::Engine::Bitmap );
+  speed_test( 1000, 1500, 150, 32768, 6163, "(10x overlap, bitmap): ", Reassembler::Engine::Bitmap );
 }
 
 int main()
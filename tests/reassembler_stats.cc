@@ -0,0 +1,123 @@
+#include "byte_stream_test_harness.hh"
+#include "random.hh"
+#include "reassembler_test_harness.hh"
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+namespace {
+// The hole count is kept as segments are stored, merged, written and evicted: check it against the stored
+// intervals after every insertion of random, overlapping, reordered segments (reading as it goes, so the bitmap
+// engine's window wraps around, and with limits, so the fragment engine evicts).
+void holes_match_intervals( Reassembler::Engine engine )
+{
+  auto rd = get_random_engine();
+  constexpr uint64_t capacity = 5000;
+  constexpr size_t total = 60000;
+
+  string d( total, 0 );
+  generate( d.begin(), d.end(), [&] { return rd(); } );
+
+  Reassembler r { ByteStream { capacity }, engine, { .max_fragments = 12, .max_overhead_bytes = 1 << 20 } };
+  string chunk;
+  while ( r.writer().bytes_pushed() < total ) {
+    const uint64_t next = r.writer().bytes_pushed();
+    const uint64_t first = next - min( next, rd() % 200 ) + rd() % ( capacity + 200 );
+    const uint64_t len = min( total - min( total, first ), rd() % 600 );
+    r.insert( first, d.substr( min<uint64_t>( first, total ), len ), first + len == total );
+
+    if ( r.stats().holes != r.stored_intervals().size() ) {
+      throw runtime_error( "holes: " + to_string( r.stats().holes ) + ", stored intervals: "
+                           + to_string( r.stored_intervals().size() ) );
+    }
+    if ( rd() % 3 == 0 ) {
+      read( r.reader(), rd() % 3000, chunk );
+    }
+  }
+}
+} // namespace
+
+int main()
+{
+  try {
+    for ( const auto engine : { Reassembler::Engine::Fragments, Reassembler::Engine::Bitmap } ) {
+      {
+        ReassemblerTestHarness test { "holes and peak", 64, engine };
+
+        test.execute( Insert { "b", 1 } );
+        test.execute( Insert { "def", 3 } );
+        test.execute( Insert { "xyz", 40 } );
+        test.execute( Holes( 3 ) );
+        test.execute( BytesPending( 7 ) );
+
+        test.execute( Insert { "c", 2 } ); // joins two fragments
+        test.execute( Holes( 2 ) );
+        test.execute( Insert { "a", 0 } );
+        test.execute( Holes( 1 ) );
+        test.execute( ReadAll( "abcdef" ) );
+        test.execute( BytesPending( 3 ) );
+        test.execute( PeakBytesPending( 8 ) );
+        test.execute( Holes( 1 ) );
+      }
+
+      {
+        ReassemblerTestHarness test { "many gaps, then subsumed", 2358, engine };
+
+        test.execute( Insert { "e", 4 } );
+        test.execute( Insert { "g", 6 } );
+        test.execute( Insert { "c", 2 } );
+        test.execute( Holes( 3 ) );
+        test.execute( Insert { "abcdefgh", 0 } );
+        test.execute( ReadAll( "abcdefgh" ) );
+        test.execute( Holes( 0 ) );
+      }
+
+      {
+        ReassemblerTestHarness test { "reorder distance", 65000, engine };
+
+        test.execute( Insert { "a", 0 } );   // in order
+        test.execute( Insert { "c", 2 } );   // 1 byte ahead
+        test.execute( Insert { "de", 3 } );  // 2 bytes ahead
+        test.execute( Insert { "h", 7 } );   // 6 bytes ahead
+        test.execute( Insert { "z", 900 } ); // 899 bytes ahead
+        test.execute( Insert { "", 0 } );    // a retransmission: not counted
+        test.execute( Insert { "b", 1 } );   // in order
+        test.execute( ReorderDistance( 0, 2 ) );
+        test.execute( ReorderDistance( 1, 1 ) );
+        test.execute( ReorderDistance( 2, 1 ) );
+        test.execute( ReorderDistance( 3, 1 ) );
+        test.execute( ReorderDistance( 10, 1 ) );
+        test.execute( BytesPushed( 5 ) );
+      }
+
+      {
+        ReassemblerTestHarness test { "duplicate bytes", 65000, engine };
+
+        test.execute( Insert { "abc", 0 } );
+        test.execute( Insert { "ab", 0 } );      // already written
+        test.execute( Insert { "cdef", 2 } );    // "c" already written
+        test.execute( DuplicateBytes( 3 ) );
+        test.execute( Insert { "hij", 7 } );
+        test.execute( Insert { "ijk", 8 } );     // "ij" already stored
+        test.execute( Insert { "ghijkl", 6 } );  // "hijk" already stored
+        test.execute( DuplicateBytes( 9 ) );
+        test.execute( Insert { "xyz", 100 } );   // new
+        test.execute( Insert { "", 7 } );
+        test.execute( DuplicateBytes( 9 ) );
+        test.execute( Insert { "g", 6 } );       // written with the rest
+        test.execute( ReadAll( "abcdefghijkl" ) );
+        test.execute( DuplicateBytes( 10 ) );
+      }
+
+      holes_match_intervals( engine );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -6,6 +6,7 @@
 
 #include <sstream>
 #include <utility>
+#include <vector>
 
 template<std::derived_from<TestStep<ByteStream>> T>
 struct ReassemblerTestStep : public TestStep<Reassembler>
@@ -25,10 +26,14 @@ struct ReassemblerTestStep : public TestStep<Reassembler>
 class ReassemblerTestHarness : public TestHarness<Reassembler>
 {
 public:
-  ReassemblerTestHarness( std::string test_name, uint64_t capacity )
+  ReassemblerTestHarness( std::string test_name,
+                          uint64_t capacity,
+                          Reassembler::Engine engine = Reassembler::Engine::Fragments,
+                          Reassembler::Limits limits = Reassembler::Limits() )
     : TestHarness( move( test_name ),
-                   "capacity=" + std::to_string( capacity ),
-                   { Reassembler { ByteStream { capacity } } } )
+                   "capacity=" + std::to_string( capacity )
+                     + ( engine == Reassembler::Engine::Bitmap ? ", bitmap engine" : "" ),
+                   { Reassembler { ByteStream { capacity }, engine, limits } } )
   {}
 
   template<std::derived_from<TestStep<ByteStream>> T>
@@ -47,6 +52,49 @@ struct BytesPending : public ExpectNumber<Reassembler, uint64_t>
   uint64_t value( const Reassembler& r ) const override { return r.count_bytes_pending(); }
 };
 
+struct FragmentsStored : public ExpectNumber<Reassembler, size_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "count_fragments"; }
+  size_t value( const Reassembler& r ) const override { return r.count_fragments(); }
+};
+
+struct FragmentsEvicted : public ExpectNumber<Reassembler, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "evictions().fragments"; }
+  uint64_t value( const Reassembler& r ) const override { return r.evictions().fragments; }
+};
+
+struct Holes : public ExpectNumber<Reassembler, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "stats().holes"; }
+  uint64_t value( const Reassembler& r ) const override { return r.stats().holes; }
+};
+
+struct PeakBytesPending : public ExpectNumber<Reassembler, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "stats().peak_bytes_pending"; }
+  uint64_t value( const Reassembler& r ) const override { return r.stats().peak_bytes_pending; }
+};
+
+struct DuplicateBytes : public ExpectNumber<Reassembler, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "stats().duplicate_bytes"; }
+  uint64_t value( const Reassembler& r ) const override { return r.stats().duplicate_bytes; }
+};
+
+struct ReorderDistance : public ExpectNumber<Reassembler, uint64_t>
+{
+  size_t bucket_;
+  ReorderDistance( size_t bucket, uint64_t count ) : ExpectNumber( count ), bucket_( bucket ) {}
+  std::string name() const override { return "stats().reorder_distance[" + std::to_string( bucket_ ) + "]"; }
+  uint64_t value( const Reassembler& r ) const override { return r.stats().reorder_distance.at( bucket_ ); }
+};
+
 struct Insert : public Action<Reassembler>
 {
   std::string data_;
@@ -73,3 +121,27 @@ struct Insert : public Action<Reassembler>
 
   void execute( Reassembler& r ) const override { r.insert( first_index_, data_, is_last_substring_ ); }
 };
+
+struct InsertMany : public Action<Reassembler>
+{
+  std::vector<Reassembler::Segment> segments_;
+
+  explicit InsertMany( std::vector<Reassembler::Segment> segments ) : segments_( move( segments ) ) {}
+
+  std::string description() const override
+  {
+    std::ostringstream ss;
+    ss << "insert batch {";
+    for ( const auto& [first_index, data, is_last_substring] : segments_ ) {
+      ss << " \"" << pretty_print( data ) << "\" @ " << first_index << ( is_last_substring ? " [last]" : "" );
+    }
+    ss << " }";
+    return ss.str();
+  }
+
+  void execute( Reassembler& r ) const override
+  {
+    auto segments = segments_;
+    r.insert_many( segments );
+  }
+};
@@ -0,0 +1,85 @@
+#include "common.hh"
+#include "tcp_peer_pair.hh"
+
+#include <algorithm>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+// (Vector links, so that a burst can be handed to TCPPeer::receive as it is)
+using Connection = TCPPeerPair<vector<TCPMessage>>;
+
+// A burst of segments, out of order, is reassembled as one batch and answered with one ACK
+void out_of_order_burst()
+{
+  Connection c { Connection::config( 1 ), Connection::config( 2 ) };
+  c.connect();
+  check( c.idle(), "the connection is idle" );
+
+  c.a.outbound_writer().push( string( 4000, 'x' ) );
+  c.a.push( c.to_b() );
+  auto segments = exchange( c.a_to_b, {} );
+  check( segments.size() == 4, "the data goes in four segments" );
+  reverse( segments.begin(), segments.end() );
+
+  c.b.receive( segments, c.to_a() );
+  check( c.b.inbound_reader().bytes_buffered() == 4000, "the burst is reassembled" );
+  check( c.b_to_a.size() == 1, "one ACK for the burst" );
+  check( c.b_to_a.front().receiver->ackno == Wrap32 { 1 } + 4001, "the ACK covers the burst" );
+}
+
+// The peer's own data, and its FIN, arriving in one burst
+void burst_with_FIN()
+{
+  Connection c { Connection::config( 1 ), Connection::config( 2 ) };
+  c.connect();
+
+  c.a.outbound_writer().push( string( 2000, 'y' ) );
+  c.a.outbound_writer().close();
+  c.a.push( c.to_b() );
+  auto segments = exchange( c.a_to_b, {} );
+
+  c.b.receive( segments, c.to_a() );
+  check( c.b.receiver().writer().is_closed(), "the inbound stream is finished" );
+  check( c.b_to_a.size() == 1, "one ACK for the burst" );
+  check( c.b_to_a.front().receiver->ackno == Wrap32 { 1 } + 2002, "the ACK covers the FIN" );
+}
+
+// A reset at the end of a burst: what arrived before it is still received
+void burst_with_RST()
+{
+  Connection c { Connection::config( 1 ), Connection::config( 2 ) };
+  c.connect();
+
+  c.a.outbound_writer().push( string( 2000, 'z' ) );
+  c.a.push( c.to_b() );
+  auto segments = exchange( c.a_to_b, {} );
+  c.a.outbound_writer().set_error();
+  segments.push_back( TCPMessage { c.a.sender().make_empty_message(), TCPReceiverMessage {} } );
+  check( segments.back().sender->RST, "the burst ends with a reset" );
+
+  c.b.receive( segments, c.to_a() );
+  check( c.b.inbound_reader().bytes_buffered() == 2000, "the data before the reset arrived" );
+  check( c.b.inbound_reader().has_error(), "the reset was received" );
+}
+} // namespace
+
+int main()
+{
+  try {
+    out_of_order_burst();
+    burst_with_FIN();
+    burst_with_RST();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
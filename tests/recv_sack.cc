@@ -0,0 +1,205 @@
+#include "helpers.hh"
+#include "random.hh"
+#include "reassembler_test_harness.hh"
+#include "receiver_test_harness.hh"
+#include "tcp_segment.hh"
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <span>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+// SACK blocks, as [begin, end) offsets from the ISN
+using Blocks = vector<pair<uint32_t, uint32_t>>;
+
+string describe( const Blocks& blocks )
+{
+  string ret = "{";
+  for ( const auto& [begin, end] : blocks ) {
+    ret += " [isn+" + to_string( begin ) + ", isn+" + to_string( end ) + ")";
+  }
+  return ret + " }";
+}
+
+struct ExpectSACKBlocks : public Expectation<TCPReceiver>
+{
+  Wrap32 isn_;
+  Blocks expected_;
+
+  ExpectSACKBlocks( Wrap32 isn, Blocks expected ) : isn_( isn ), expected_( move( expected ) ) {}
+
+  std::string description() const override { return "SACK blocks = " + describe( expected_ ); }
+
+  void execute( const TCPReceiver& rs ) const override
+  {
+    Blocks actual;
+    for ( const auto& [begin, end] : rs.send().SACK_blocks ) {
+      actual.emplace_back( begin.unwrap( isn_, 0 ), end.unwrap( isn_, 0 ) );
+    }
+    if ( actual != expected_ ) {
+      throw ExpectationViolation( "SACK blocks were " + describe( actual ) );
+    }
+  }
+};
+
+// Both engines report the same stored intervals, merging adjacent fragments
+void stored_intervals()
+{
+  for ( const auto engine : { Reassembler::Engine::Fragments, Reassembler::Engine::Bitmap } ) {
+    Reassembler reassembler { ByteStream { 100 }, engine };
+    reassembler.insert( 10, "abc", false );
+    reassembler.insert( 13, "de", false );
+    reassembler.insert( 20, "f", false );
+    reassembler.insert( 98, "ghijk", false ); // (cut at the end of the window)
+    const auto intervals = reassembler.stored_intervals();
+    check( intervals.size() == 3, "three intervals" );
+    check( intervals[0].begin == 10 and intervals[0].end == 15, "adjacent fragments are one interval" );
+    check( intervals[1].begin == 20 and intervals[1].end == 21, "a one-byte interval" );
+    check( intervals[2].begin == 98 and intervals[2].end == 100, "an interval at the end of the window" );
+  }
+}
+
+// The capped query: the interval holding a given byte first, then the others in order, as many as fit
+void capped_intervals()
+{
+  for ( const auto engine : { Reassembler::Engine::Fragments, Reassembler::Engine::Bitmap } ) {
+    Reassembler reassembler { ByteStream { 300 }, engine };
+    reassembler.insert( 10, "abc", false );
+    reassembler.insert( 13, "de", false );
+    reassembler.insert( 20, "f", false );
+    reassembler.insert( 60, string( 70, 'x' ), false );
+    reassembler.insert( 130, string( 70, 'y' ), false ); // (one interval of several 64-bit words)
+    reassembler.insert( 250, "g", false );
+
+    array<Reassembler::Interval, 4> out {};
+    const auto got = [&]( size_t count ) {
+      vector<pair<uint64_t, uint64_t>> ret;
+      for ( size_t i = 0; i < count; ++i ) {
+        ret.emplace_back( out.at( i ).begin, out.at( i ).end );
+      }
+      return ret;
+    };
+    using Expected = vector<pair<uint64_t, uint64_t>>;
+    const Expected in_order { { 10, 15 }, { 20, 21 }, { 60, 200 }, { 250, 251 } };
+    const Expected two { { 60, 200 }, { 10, 15 } };
+    check( got( reassembler.stored_intervals( span { out }.first( 2 ), 100 ) ) == two,
+           "the interval holding the byte first, then the first of the others" );
+    check( got( reassembler.stored_intervals( out, 14 ) ) == in_order, "the holding interval isn't repeated" );
+    check( got( reassembler.stored_intervals( out, 16 ) ) == in_order, "in order, if the byte isn't stored" );
+    check( got( reassembler.stored_intervals( span { out }.first( 1 ), 250 ) ) == Expected { { 250, 251 } },
+           "only the holding interval, if only one fits" );
+    check( reassembler.stored_intervals( span { out }.first( 0 ), 250 ) == 0, "nothing, if nothing fits" );
+
+    // Against the full list, at random
+    auto rd = get_random_engine();
+    for ( size_t i = 0; i < 100; ++i ) {
+      const uint64_t index = 1 + rd() % 299;
+      reassembler.insert( index, string( 1 + rd() % 4, 'z' ), false );
+      const auto all = reassembler.stored_intervals();
+      const uint64_t probe = rd() % 300;
+      Expected expected;
+      for ( const auto& interval : all ) {
+        if ( interval.begin <= probe and probe < interval.end ) {
+          expected.emplace_back( interval.begin, interval.end );
+        }
+      }
+      for ( const auto& interval : all ) {
+        if ( expected.size() < out.size() and not( interval.begin <= probe and probe < interval.end ) ) {
+          expected.emplace_back( interval.begin, interval.end );
+        }
+      }
+      check( got( reassembler.stored_intervals( out, probe ) ) == expected, "the same intervals as the full list" );
+    }
+  }
+}
+
+// The options survive serialization and parsing (and the payload still begins in the right place)
+void segment_options()
+{
+  TCPSegment segment;
+  segment.message.sender->seqno = Wrap32 { 1000 };
+  segment.message.sender->SYN = true;
+  segment.message.sender->SACK_permitted = true;
+  segment.message.sender->payload = "hello";
+  segment.message.receiver->ackno = Wrap32 { 2000 };
+  for ( uint32_t i = 0; i < 5; ++i ) {
+    segment.message.receiver->SACK_blocks.push_back( { Wrap32 { 3000 + 100 * i }, Wrap32 { 3050 + 100 * i } } );
+  }
+  segment.compute_checksum( 0 );
+
+  TCPSegment parsed;
+  check( parse( parsed, serialize( segment ), 0 ), "segment with options parses" );
+  check( parsed.message.sender->SYN and parsed.message.sender->SACK_permitted, "SACK-permitted option" );
+  check( parsed.message.sender->payload == "hello", "payload after the options" );
+  check( parsed.message.receiver->SACK_blocks.size() == 4, "as many SACK blocks as fit in the options" );
+  check( parsed.message.receiver->SACK_blocks[2].begin == Wrap32 { 3200 }
+           and parsed.message.receiver->SACK_blocks[2].end == Wrap32 { 3250 },
+         "SACK block edges" );
+
+  segment.message.receiver->ackno.reset();
+  segment.compute_checksum( 0 );
+  check( parse( parsed = {}, serialize( segment ), 0 ), "segment without ACK parses" );
+  check( parsed.message.receiver->SACK_blocks.empty(), "no SACK blocks without an ACK" );
+}
+} // namespace
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    stored_intervals();
+    capped_intervals();
+    segment_options();
+
+    {
+      const Wrap32 isn( rd() );
+      TCPReceiverTestHarness test { "SACK blocks follow the stored segments", 4000 };
+      test.execute( SegmentArrives {}.with_syn().with_SACK_permitted().with_seqno( isn ) );
+      test.execute( ExpectSACKBlocks { isn, {} } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 5 ).with_data( "efgh" ) );
+      test.execute( ExpectAckno { isn + 1 } );
+      test.execute( ExpectSACKBlocks { isn, { { 5, 9 } } } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 13 ).with_data( "mn" ) );
+      test.execute( ExpectSACKBlocks { isn, { { 13, 15 }, { 5, 9 } } } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 9 ).with_data( "ij" ) );
+      test.execute( ExpectSACKBlocks { isn, { { 5, 11 }, { 13, 15 } } } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "abcd" ) );
+      test.execute( ExpectAckno { isn + 11 } );
+      test.execute( ExpectSACKBlocks { isn, { { 13, 15 } } } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 11 ).with_data( "kl" ) );
+      test.execute( ExpectAckno { isn + 15 } );
+      test.execute( ExpectSACKBlocks { isn, {} } );
+    }
+
+    {
+      const Wrap32 isn( rd() );
+      TCPReceiverTestHarness test { "no more than four SACK blocks, the latest first", 4000 };
+      test.execute( SegmentArrives {}.with_syn().with_SACK_permitted().with_seqno( isn ) );
+      for ( uint32_t i = 1; i <= 6; ++i ) {
+        test.execute( SegmentArrives {}.with_seqno( isn + 10 * i ).with_data( "x" ) );
+      }
+      test.execute( ExpectSACKBlocks { isn, { { 60, 61 }, { 10, 11 }, { 20, 21 }, { 30, 31 } } } );
+    }
+
+    {
+      const Wrap32 isn( rd() );
+      TCPReceiverTestHarness test { "no SACK blocks unless the SYN permitted them", 4000 };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 5 ).with_data( "efgh" ) );
+      test.execute( BytesPending { 4 } );
+      test.execute( ExpectSACKBlocks { isn, {} } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
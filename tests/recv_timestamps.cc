@@ -0,0 +1,110 @@
+#include "helpers.hh"
+#include "byte_stream_test_harness.hh"
+#include "random.hh"
+#include "reassembler_test_harness.hh"
+#include "receiver_test_harness.hh"
+#include "tcp_segment.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+namespace {
+// The option survives serialization and parsing, and leaves room for three SACK blocks
+void segment_option()
+{
+  TCPSegment segment;
+  segment.message.sender->seqno = Wrap32 { 1000 };
+  segment.message.sender->timestamp = 123456;
+  segment.message.sender->payload = "hello";
+  segment.message.receiver->ackno = Wrap32 { 2000 };
+  segment.message.receiver->timestamp_echo = 654321;
+  for ( uint32_t i = 0; i < 4; ++i ) {
+    segment.message.receiver->SACK_blocks.push_back( { Wrap32 { 3000 + 100 * i }, Wrap32 { 3050 + 100 * i } } );
+  }
+  segment.compute_checksum( 0 );
+  check( segment.header_length() == TCPSegment::HEADER_LENGTH + 12 + 4 + 3 * 8, "header length" );
+
+  TCPSegment parsed;
+  check( parse( parsed, serialize( segment ), 0 ), "segment with timestamps parses" );
+  check( parsed.message.sender->timestamp == 123456, "timestamp" );
+  check( parsed.message.receiver->timestamp_echo == 654321, "timestamp echo" );
+  check( parsed.message.receiver->SACK_blocks.size() == 3, "SACK blocks in the rest of the room" );
+  check( parsed.message.sender->payload == "hello", "payload after the options" );
+
+  segment.message.receiver->ackno.reset();
+  segment.compute_checksum( 0 );
+  check( parse( parsed = {}, serialize( segment ), 0 ), "segment without ACK parses" );
+  check( parsed.message.sender->timestamp == 123456, "timestamp without ACK" );
+  check( not parsed.message.receiver->timestamp_echo.has_value(), "no echo without an ACK" );
+
+  segment.message.sender->timestamp.reset();
+  segment.compute_checksum( 0 );
+  check( parse( parsed = {}, serialize( segment ), 0 ), "segment without timestamps parses" );
+  check( not parsed.message.sender->timestamp.has_value(), "no timestamp unless set" );
+}
+} // namespace
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    segment_option();
+
+    {
+      const Wrap32 isn( rd() );
+      TCPReceiverTestHarness test { "echo the timestamp of the latest in-order segment", 4000 };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ).with_timestamp( 100 ) );
+      test.execute( ExpectTimestampEcho { 100 } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "abc" ).with_timestamp( 105 ) );
+      test.execute( ExpectTimestampEcho { 105 } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 10 ).with_data( "jkl" ).with_timestamp( 110 ) );
+      test.execute( ExpectTimestampEcho { 105 } ); // (out of order)
+      test.execute( SegmentArrives {}.with_seqno( isn + 4 ).with_data( "defghi" ).with_timestamp( 111 ) );
+      test.execute( ExpectAckno { isn + 13 } );
+      test.execute( ExpectTimestampEcho { 111 } );
+    }
+
+    {
+      const Wrap32 isn( rd() );
+      TCPReceiverTestHarness test { "PAWS rejects segments with old timestamps", 4000 };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ).with_timestamp( 1000 ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "abc" ).with_timestamp( 1005 ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 4 ).with_data( "def" ).with_timestamp( 990 ) );
+      test.execute( ExpectAckno { isn + 4 } );
+      test.execute( BytesPending { 0 } );
+      test.execute( ExpectTimestampEcho { 1005 } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 4 ).with_data( "def" ).with_timestamp( 1005 ) );
+      test.execute( ExpectAckno { isn + 7 } );
+      test.execute( ReadAll { "abcdef" } );
+    }
+
+    {
+      const Wrap32 isn( rd() );
+      TCPReceiverTestHarness test { "timestamps compare across wraparound", 4000 };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ).with_timestamp( UINT32_MAX - 10 ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "abc" ).with_timestamp( 5 ) );
+      test.execute( ExpectAckno { isn + 4 } );
+      test.execute( ExpectTimestampEcho { 5 } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 4 ).with_data( "def" ).with_timestamp( UINT32_MAX ) );
+      test.execute( ExpectAckno { isn + 4 } );
+    }
+
+    {
+      const Wrap32 isn( rd() );
+      TCPReceiverTestHarness test { "no echo without timestamps", 4000 };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "abc" ) );
+      test.execute( ExpectTimestampEcho { nullopt } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
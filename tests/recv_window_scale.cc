@@ -0,0 +1,158 @@
+#include "helpers.hh"
+#include "random.hh"
+#include "receiver_test_harness.hh"
+#include "tcp_peer_pair.hh"
+#include "tcp_segment.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+namespace {
+struct ScaleWindow : public Action<TCPReceiver>
+{
+  uint8_t shift_;
+
+  explicit ScaleWindow( uint8_t shift ) : shift_( shift ) {}
+  std::string description() const override { return "scale window by 2^" + to_string( shift_ ); }
+  void execute( TCPReceiver& rs ) const override { rs.scale_window( shift_ ); }
+};
+
+// The shift offered is the smallest that covers the receive capacity
+void window_shift()
+{
+  TCPConfig cfg;
+  check( cfg.window_shift() == 0, "no shift for the default capacity" );
+  cfg.recv_capacity = UINT16_MAX + 1;
+  check( cfg.window_shift() == 1, "shift of 1 just past 64 KiB" );
+  cfg.recv_capacity = 4 << 20;
+  check( cfg.window_shift() == 7, "shift of 7 for 4 MiB" );
+  cfg.recv_capacity = uint64_t { 1 } << 40;
+  check( cfg.window_shift() == TCPConfig::MAX_WINDOW_SHIFT, "shift capped at 14" );
+}
+
+// The option survives serialization and parsing, and counts towards the header length
+void segment_option()
+{
+  TCPSegment segment;
+  segment.message.sender->seqno = Wrap32 { 1000 };
+  segment.message.sender->SYN = true;
+  segment.message.sender->SACK_permitted = true;
+  segment.message.sender->window_scale = 7;
+  segment.message.sender->payload = "hello";
+  segment.message.receiver->ackno = Wrap32 { 2000 };
+  segment.message.receiver->window_size = 100'000; // (sent as 65535)
+  for ( uint32_t i = 0; i < 4; ++i ) {
+    segment.message.receiver->SACK_blocks.push_back( { Wrap32 { 3000 + 100 * i }, Wrap32 { 3050 + 100 * i } } );
+  }
+  segment.compute_checksum( 0 );
+  check( segment.header_length() == TCPSegment::HEADER_LENGTH + 4 + 4 + 4 + 3 * 8, "header length" );
+
+  TCPSegment parsed;
+  check( parse( parsed, serialize( segment ), 0 ), "segment with window scale parses" );
+  check( parsed.message.sender->window_scale == 7, "window scale option" );
+  check( parsed.message.sender->SACK_permitted, "SACK-permitted option alongside it" );
+  check( parsed.message.receiver->SACK_blocks.size() == 3, "one SACK block fewer fits" );
+  check( parsed.message.receiver->window_size == UINT16_MAX, "window field saturates" );
+  check( parsed.message.sender->payload == "hello", "payload after the options" );
+
+  segment.message.sender->SYN = false;
+  segment.compute_checksum( 0 );
+  check( parse( parsed = {}, serialize( segment ), 0 ), "segment without SYN parses" );
+  check( not parsed.message.sender->window_scale.has_value(), "window scale only with SYN" );
+}
+
+// Two TCPPeers, over serialized segments, noting the most in flight from the first to the second and the last
+// window the second sent
+struct Connection : public TCPPeerPair<>
+{
+  uint64_t peak_in_flight {};
+  uint32_t last_window_from_b {}; // (as sent)
+
+  Connection( const TCPConfig& a_cfg, const TCPConfig& b_cfg ) : TCPPeerPair( a_cfg, b_cfg ) { serialized = true; }
+
+  void transfer( uint64_t bytes )
+  {
+    a.outbound_writer().push( string( bytes, 'x' ) );
+    a.push( to_b() );
+    for ( int i = 0; i < 8; ++i ) {
+      deliver_to_b();
+      if ( not b_to_a.empty() ) {
+        last_window_from_b = b_to_a.back().receiver->window_size;
+      }
+      deliver_to_a();
+      peak_in_flight = max( peak_in_flight, a.sender().sequence_numbers_in_flight() );
+    }
+    check( b.inbound_reader().bytes_buffered() == bytes, "all bytes arrived" );
+  }
+};
+
+TCPConfig big_window_config( uint16_t isn )
+{
+  TCPConfig cfg = Connection::config( isn );
+  cfg.send_capacity = 4 << 20;
+  cfg.recv_capacity = 4 << 20;
+  cfg.congestion_control = TCPConfig::Congestion::None;
+  cfg.window_scaling = true;
+  return cfg;
+}
+
+// With both sides scaling, the whole 4 MiB can be in flight at once; if either side doesn't, only 64 KiB
+void peers()
+{
+  {
+    Connection c { big_window_config( 1 ), big_window_config( 2 ) };
+    c.transfer( 2 << 20 );
+    check( c.peak_in_flight > UINT16_MAX, "window scaled past 64 KiB" );
+    check( c.last_window_from_b == ( 2 << 20 ) >> 7, "window sent scaled down" );
+  }
+
+  for ( const bool a_scales : { true, false } ) {
+    TCPConfig a_cfg = big_window_config( 1 );
+    TCPConfig b_cfg = big_window_config( 2 );
+    a_cfg.window_scaling = a_scales;
+    b_cfg.window_scaling = not a_scales;
+    Connection c { a_cfg, b_cfg };
+    c.transfer( 300'000 );
+    check( c.peak_in_flight <= UINT16_MAX, "no scaling unless both SYNs offered it" );
+  }
+}
+} // namespace
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    window_shift();
+    segment_option();
+    peers();
+
+    {
+      TCPReceiverTestHarness test { "window past 64 KiB once scaled", 10'000'000 };
+      test.execute( ExpectWindow { UINT16_MAX } );
+      test.execute( ScaleWindow { 7 } );
+      test.execute( ExpectWindow { 8'388'480 } ); // (65535 << 7)
+      test.execute( ScaleWindow { 8 } );
+      test.execute( ExpectWindow { 10'000'000 } );
+    }
+
+    {
+      const Wrap32 isn( rd() );
+      TCPReceiverTestHarness test { "scaled window shrinks as data arrives", 1'000'000 };
+      test.execute( ScaleWindow { 5 } );
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( string( 100'000, 'x' ) ) );
+      test.execute( ExpectWindow { 900'000 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,122 @@
+#include "byte_stream_test_harness.hh"
+#include "random.hh"
+#include "receiver_test_harness.hh"
+#include "tcp_peer_pair.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+namespace {
+using Connection = TCPPeerPair<>;
+
+struct ExpectWindowUpdateDue : public Expectation<TCPReceiver>
+{
+  Wrap32 advertised_ackno_;
+  uint64_t advertised_window_;
+  bool expected_;
+
+  ExpectWindowUpdateDue( Wrap32 advertised_ackno, uint64_t advertised_window, bool expected )
+    : advertised_ackno_( advertised_ackno ), advertised_window_( advertised_window ), expected_( expected )
+  {}
+
+  std::string description() const override
+  {
+    return string( "window update " ) + ( expected_ ? "" : "not " ) + "due, after advertising "
+           + to_string( advertised_window_ );
+  }
+
+  void execute( const TCPReceiver& rs ) const override
+  {
+    if ( rs.window_update_due( advertised_ackno_, advertised_window_ ) != expected_ ) {
+      throw ExpectationViolation( string( "window update was " ) + ( expected_ ? "not " : "" ) + "due" );
+    }
+  }
+};
+
+// A sender, and a receiver whose application doesn't read until the window is closed. Once it does, the
+// receiving peer tells the sender at its next tick, rather than waiting for the sender's probe.
+void slow_reader()
+{
+  TCPConfig b_cfg = Connection::config( 2 );
+  b_cfg.recv_capacity = 4000;
+  Connection c { Connection::config( 1 ), b_cfg };
+  c.connect();
+  c.a.outbound_writer().push( string( 10'000, 'x' ) );
+  c.a.push( c.to_b() );
+  for ( int i = 0; i < 8; ++i ) {
+    c.round_trip();
+  }
+  check( c.b.inbound_reader().bytes_buffered() == 4000, "the receive window filled" );
+  check( c.idle(), "the connection is idle" );
+
+  c.b.tick( 1, c.to_a() );
+  check( c.b_to_a.empty(), "no window update before the application reads" );
+
+  c.b.inbound_reader().pop( 4000 );
+  c.b.tick( 1, c.to_a() );
+  check( c.b_to_a.size() == 1, "one window update once it does" );
+  check( c.b_to_a.front().receiver->window_size == 4000, "the window update has the window" );
+  c.b.tick( 1, c.to_a() );
+  check( c.b_to_a.size() == 1, "only one window update" );
+
+  c.a.receive( move( c.b_to_a.front() ), c.to_b() );
+  c.b_to_a.pop_front();
+  check( not c.a_to_b.empty(), "the sender sends again at once" );
+}
+} // namespace
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    slow_reader();
+
+    {
+      const Wrap32 isn( rd() );
+      TCPReceiverTestHarness test { "window update once the window opens by a segment", 4000 };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( ExpectWindowUpdateDue { isn + 1, 4000, false } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( string( 4000, 'x' ) ) );
+      test.execute( ExpectWindow { 0 } );
+      test.execute( ExpectWindowUpdateDue { isn + 4001, 0, false } );
+      test.execute( Pop { 500 } );
+      test.execute( ExpectWindowUpdateDue { isn + 4001, 0, false } ); // (too small to be worth sending)
+      test.execute( Pop { 500 } );
+      test.execute( ExpectWindowUpdateDue { isn + 4001, 0, true } );
+      test.execute( ExpectWindowUpdateDue { isn + 4001, 1000, false } ); // (once sent)
+      test.execute( Pop { 2000 } );
+      test.execute( ExpectWindowUpdateDue { isn + 4001, 1000, true } );
+      test.execute( ExpectWindowUpdateDue { isn + 4001, 2000, false } ); // (the sender knows of more than half)
+    }
+
+    {
+      const Wrap32 isn( rd() );
+      TCPReceiverTestHarness test { "half the capacity is enough, for a small one", 600 };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( string( 600, 'x' ) ) );
+      test.execute( Pop { 299 } );
+      test.execute( ExpectWindowUpdateDue { isn + 601, 0, false } );
+      test.execute( Pop { 1 } );
+      test.execute( ExpectWindowUpdateDue { isn + 601, 0, true } );
+    }
+
+    {
+      const Wrap32 isn( rd() );
+      TCPReceiverTestHarness test { "no window update after the FIN", 4000 };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( string( 4000, 'x' ) ).with_fin() );
+      test.execute( Pop { 4000 } );
+      test.execute( ExpectWindowUpdateDue { isn + 4002, 0, false } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,165 @@
+#include "congestion_control.hh"
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+namespace {
+constexpr uint64_t mss = 1000;
+
+void new_reno()
+{
+  NewReno cc { mss };
+  check( cc.cwnd() == 4 * mss, "initial window is four segments" );
+
+  for ( int i = 0; i < 4; ++i ) {
+    cc.on_ack( mss, 0, 0 );
+  }
+  check( cc.cwnd() == 8 * mss, "slow start grows a segment per segment acknowledged" );
+
+  cc.on_loss( 8 * mss, 0 );
+  check( cc.ssthresh() == 4 * mss and cc.cwnd() == 4 * mss, "a loss halves the flight" );
+
+  for ( int i = 0; i < 3; ++i ) {
+    cc.on_ack( mss, 0, 0 );
+  }
+  check( cc.cwnd() == 4 * mss, "congestion avoidance waits for a whole window" );
+  cc.on_ack( mss, 0, 0 );
+  check( cc.cwnd() == 5 * mss, "congestion avoidance grows a segment per window" );
+
+  cc.on_rto( 5 * mss, 0 );
+  check( cc.ssthresh() == 2 * mss + mss / 2 and cc.cwnd() == mss, "a timeout starts over from one segment" );
+  cc.on_rto( mss, 0 );
+  check( cc.ssthresh() == 2 * mss, "ssthresh is at least two segments" );
+}
+
+// One RTT's worth of ACKs, a segment at a time
+void ack_window( CongestionControl& cc, uint64_t& now_ms, uint64_t RTT_ms )
+{
+  now_ms += RTT_ms;
+  for ( uint64_t acked = 0, window = cc.cwnd(); acked < window; acked += mss ) {
+    cc.on_ack( mss, now_ms, RTT_ms );
+  }
+}
+
+void cubic()
+{
+  Cubic cc { mss };
+  uint64_t now_ms = 0;
+  constexpr uint64_t RTT_ms = 100;
+  while ( cc.cwnd() < 50 * mss ) {
+    ack_window( cc, now_ms, RTT_ms );
+  }
+  const uint64_t W_max = cc.cwnd();
+
+  cc.on_loss( W_max, now_ms );
+  check( cc.cwnd() == static_cast<uint64_t>( static_cast<double>( W_max ) * Cubic::beta ),
+         "a loss reduces the window by beta" );
+
+  // Concave approach to W_max: fast at first, slower as it gets close, and there at about K seconds
+  const double K = cbrt( static_cast<double>( W_max ) / mss * ( 1 - Cubic::beta ) / Cubic::C );
+  const uint64_t epoch_start = now_ms;
+  uint64_t first_second_growth = 0;
+  uint64_t before = cc.cwnd();
+  while ( static_cast<double>( now_ms - epoch_start ) < 1000 * K - RTT_ms ) {
+    ack_window( cc, now_ms, RTT_ms );
+    check( cc.cwnd() <= W_max, "the window stays below W_max before K" );
+    if ( now_ms - epoch_start == 1000 ) {
+      first_second_growth = cc.cwnd() - before;
+      before = cc.cwnd();
+    }
+  }
+  check( cc.cwnd() - before < first_second_growth, "growth slows down close to W_max" );
+  check( cc.cwnd() + 2 * mss >= W_max, "the window is back near W_max after K seconds" );
+
+  // Convex probing past W_max
+  for ( int i = 0; i < 30; ++i ) {
+    ack_window( cc, now_ms, RTT_ms );
+  }
+  check( cc.cwnd() > W_max + 5 * mss, "the window grows past W_max" );
+
+  // A loss below the previous W_max gives way to newer flows (fast convergence)
+  const uint64_t second_max = cc.cwnd();
+  cc.on_loss( second_max, now_ms );
+  check( cc.cwnd() < second_max, "second loss reduces the window" );
+  cc.on_rto( cc.cwnd(), now_ms );
+  check( cc.cwnd() == mss, "a timeout starts over from one segment" );
+}
+} // namespace
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+    constexpr TCPSenderTestHarness::FullConfig full {};
+
+    new_reno();
+    cubic();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.congestion_control = TCPConfig::Congestion::NewReno;
+
+      TCPSenderTestHarness test { "Sender respects the congestion window", cfg, full };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_seqno( isn ) );
+      test.execute( Receive { { isn + 1, 60000 } }.without_push() ); // (the SYN didn't fill the window)
+      test.execute( Push { string( 10000, 'x' ) } );
+      for ( uint32_t i = 0; i < 4; ++i ) {
+        test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1 + 1000 * i ) );
+      }
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSeqnosInFlight { 4000 } );
+
+      test.execute( Receive { { isn + 4001, 60000 } } ); // slow start: one more segment
+      for ( uint32_t i = 0; i < 5; ++i ) {
+        test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      }
+      test.execute( ExpectNoSegment {} );
+
+      test.execute( Receive { { isn + 9001, 60000 } }.with_win( 3000 ) ); // the receiver's window is smaller
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      test.execute( Push { string( 5000, 'y' ) } );
+      for ( uint32_t i = 0; i < 2; ++i ) {
+        test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      }
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSeqnosInFlight { 3000 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.congestion_control = TCPConfig::Congestion::NewReno;
+
+      TCPSenderTestHarness test { "Timeout shrinks the congestion window", cfg, full };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Receive { { isn + 1, 60000 } }.without_push() );
+      test.execute( Push { string( 4000, 'x' ) } );
+      for ( uint32_t i = 0; i < 4; ++i ) {
+        test.execute( ExpectMessage {} );
+      }
+      test.execute( Tick { 1000 } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 1 ) );
+      test.execute( Receive { { isn + 4001, 60000 } } ); // cwnd = 1 MSS, then slow start
+      test.execute( Push { string( 5000, 'y' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
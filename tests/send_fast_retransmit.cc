@@ -0,0 +1,167 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+struct ExpectFastRecovery : public ExpectBool<TCPSender>
+{
+  using ExpectBool::ExpectBool;
+  std::string name() const override { return "in_fast_recovery"; }
+  bool value( const TCPSender& sender ) const override { return sender.in_fast_recovery(); }
+};
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+    constexpr TCPSenderTestHarness::FullConfig full {};
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.fast_retransmit = true;
+      cfg.congestion_control = TCPConfig::Congestion::NewReno;
+
+      TCPSenderTestHarness test { "Three duplicate ACKs, a partial ACK, then a full ACK", cfg, full };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Receive { { isn + 1, 60000 } }.without_push() );
+      test.execute( Push { string( 4000, 'x' ) } );
+      for ( uint32_t i = 0; i < 4; ++i ) {
+        test.execute( ExpectMessage {}.with_seqno( isn + 1 + 1000 * i ) );
+      }
+
+      // The first two segments are lost: the next two each bring a duplicate ACK
+      test.execute( Receive { { isn + 1, 60000 } } );
+      test.execute( Receive { { isn + 1, 60000 } } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectFastRecovery { false } );
+      test.execute( Receive { { isn + 1, 60000 } } ); // (e.g. from a reordered segment)
+      test.execute( ExpectMessage {}.with_seqno( isn + 1 ).with_payload_size( 1000 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectFastRecovery { true } );
+      test.execute( ExpectConsecutiveRetransmissions { 0 } );
+
+      // cwnd is halved to 2000, plus 3000 for the segments that left: room for one more
+      test.execute( Push { string( 4000, 'y' ) } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 4001 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Receive { { isn + 1, 60000 } } ); // each further duplicate lets another segment out
+      test.execute( ExpectMessage {}.with_seqno( isn + 5001 ) );
+      test.execute( ExpectNoSegment {} );
+
+      // The retransmission arrives, and the ACK stops at the second hole, which is retransmitted at once
+      test.execute( Receive { { isn + 1001, 60000 } } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 1001 ).with_payload_size( 1000 ) );
+      test.execute( ExpectMessage {}.with_seqno( isn + 6001 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectFastRecovery { true } );
+
+      // Everything sent before recovery began is acknowledged: back to cwnd = ssthresh
+      test.execute( Receive { { isn + 6001, 60000 } } );
+      test.execute( ExpectFastRecovery { false } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 7001 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSeqnosInFlight { 2000 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.fast_retransmit = true;
+
+      TCPSenderTestHarness test { "Two duplicates, or a window update, don't trigger it", cfg, full };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Receive { { isn + 1, 60000 } }.without_push() );
+      test.execute( Push { string( 3000, 'x' ) } );
+      for ( uint32_t i = 0; i < 3; ++i ) {
+        test.execute( ExpectMessage {} );
+      }
+      test.execute( Receive { { isn + 1, 60000 } } );
+      test.execute( Receive { { isn + 1, 60000 } } );
+      test.execute( Receive { { isn + 1, 61000 } } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectFastRecovery { false } );
+      test.execute( Tick { cfg.rt_timeout } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 1 ) );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.fast_retransmit = true;
+      cfg.congestion_control = TCPConfig::Congestion::NewReno;
+
+      TCPSenderTestHarness test { "Duplicates of data sent before a timeout don't trigger it", cfg, full };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Receive { { isn + 1, 60000 } }.without_push() );
+      test.execute( Push { string( 4000, 'x' ) } );
+      for ( uint32_t i = 0; i < 4; ++i ) {
+        test.execute( ExpectMessage {} );
+      }
+      test.execute( Tick { cfg.rt_timeout } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 1 ) );
+      for ( uint32_t i = 0; i < 3; ++i ) {
+        test.execute( Receive { { isn + 1, 60000 } } );
+      }
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectFastRecovery { false } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.fast_retransmit = false;
+
+      TCPSenderTestHarness test { "Fast retransmit can be turned off", cfg, full };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Receive { { isn + 1, 60000 } }.without_push() );
+      test.execute( Push { string( 4000, 'x' ) } );
+      for ( uint32_t i = 0; i < 4; ++i ) {
+        test.execute( ExpectMessage {} );
+      }
+      for ( uint32_t i = 0; i < 3; ++i ) {
+        test.execute( Receive { { isn + 1, 60000 } } );
+      }
+      test.execute( ExpectNoSegment {} );
+    }
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.fast_retransmit = true;
+      cfg.congestion_control = TCPConfig::Congestion::NewReno;
+
+      TCPSenderTestHarness test { "ACKs on the peer's data segments are not duplicates", cfg, full };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Receive { { isn + 1, 60000 } }.without_push() );
+      test.execute( Push { string( 4000, 'x' ) } );
+      for ( uint32_t i = 0; i < 4; ++i ) {
+        test.execute( ExpectMessage {} );
+      }
+      for ( uint32_t i = 0; i < 4; ++i ) {
+        test.execute( Receive { { isn + 1, 60000 } }.on_data_segment() );
+      }
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectFastRecovery { false } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,84 @@
+#include "common.hh"
+#include "tcp_peer_pair.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+namespace {
+using Connection = TCPPeerPair<>;
+
+TCPConfig config( uint32_t isn )
+{
+  TCPConfig cfg = Connection::config( isn );
+  cfg.rt_timeout = 1000;
+  return cfg;
+}
+
+void settle( Connection& c )
+{
+  for ( int i = 0; i < 8; ++i ) {
+    c.cross();
+  }
+  check( c.idle(), "the connection is idle" );
+}
+
+void send_and_close( TCPPeer& peer, const auto& transmit, const string& data )
+{
+  peer.outbound_writer().push( data );
+  peer.outbound_writer().close();
+  peer.push( transmit );
+}
+
+// Each side sends its FIN before the other's arrives: both must linger, in case their ACK of the other's FIN
+// was lost
+void simultaneous_close()
+{
+  Connection c { config( 1 ), config( 2 ) };
+  c.a.push( c.to_b() );
+  settle( c );
+
+  send_and_close( c.a, c.to_b(), "hello" );
+  send_and_close( c.b, c.to_a(), "world" );
+  settle( c );
+  check( c.a.receiver().writer().is_closed() and c.b.receiver().writer().is_closed(), "both FINs arrived" );
+  check( c.a.sender().sequence_numbers_in_flight() == 0 and c.b.sender().sequence_numbers_in_flight() == 0,
+         "both FINs acknowledged" );
+  check( c.a.active() and c.b.active(), "both peers linger" );
+
+  c.a.tick( 10 * 1000, c.to_b() );
+  c.b.tick( 10 * 1000, c.to_a() );
+  check( not c.a.active() and not c.b.active(), "both peers done lingering" );
+}
+
+// The side whose inbound stream finished first (the passive closer) need not linger; the other must
+void passive_close()
+{
+  Connection c { config( 1 ), config( 2 ) };
+  c.a.push( c.to_b() );
+  settle( c );
+
+  send_and_close( c.a, c.to_b(), "hello" );
+  settle( c );
+  send_and_close( c.b, c.to_a(), "world" );
+  settle( c );
+  check( c.a.active(), "the active closer lingers" );
+  check( not c.b.active(), "the passive closer doesn't" );
+}
+} // namespace
+
+int main()
+{
+  try {
+    simultaneous_close();
+    passive_close();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,144 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+
+using namespace std;
+
+struct ExpectPacingRate : public ExpectNumber<TCPSender, optional<uint64_t>>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "pacing_rate"; }
+  optional<uint64_t> value( const TCPSender& sender ) const override { return sender.pacing_rate(); }
+};
+
+struct ExpectPacingDelay : public ExpectNumber<TCPSender, optional<uint64_t>>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "pacing_delay_ms"; }
+  optional<uint64_t> value( const TCPSender& sender ) const override { return sender.pacing_delay_ms(); }
+};
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+    constexpr TCPSenderTestHarness::FullConfig full {};
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.congestion_control = TCPConfig::Congestion::NewReno;
+      cfg.pacing = true;
+
+      TCPSenderTestHarness test { "Segments are let out at twice cwnd per RTT in slow start", cfg, full };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( ExpectPacingRate { nullopt } ); // (no RTT yet)
+      test.execute( Tick { 100 } );
+      test.execute( Receive { { isn + 1, 60000 } }.without_push() );
+      test.execute( ExpectPacingRate { 80'000 } ); // 2 * 4000 bytes per 100 ms
+
+      // The bucket starts with two segments' worth
+      test.execute( Push { string( 4000, 'x' ) } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 1 ) );
+      test.execute( ExpectMessage {}.with_seqno( isn + 1001 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectPacingDelay { 1 } );
+
+      // Then 80 bytes a millisecond: a segment may overdraw the bucket, and the next waits until it's repaid
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 2001 ) );
+      test.execute( ExpectPacingDelay { 12 } );
+      test.execute( Tick { 11 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 3001 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectPacingDelay { nullopt } ); // (nothing left to send)
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.congestion_control = TCPConfig::Congestion::NewReno;
+      cfg.pacing = true;
+
+      TCPSenderTestHarness test { "An idle sender doesn't save up for a burst", cfg, full };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Tick { 100 } );
+      test.execute( Receive { { isn + 1, 60000 } }.without_push() );
+      test.execute( Tick { 1000 } );
+      test.execute( Push { string( 4000, 'x' ) } );
+      test.execute( ExpectMessage {} );
+      test.execute( ExpectMessage {} );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.congestion_control = TCPConfig::Congestion::NewReno;
+      cfg.pacing = true;
+
+      TCPSenderTestHarness test { "Nothing waits for the pacer while the window is full", cfg, full };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Tick { 100 } );
+      test.execute( Receive { { isn + 1, 1000 } }.without_push() );
+      test.execute( Push { string( 4000, 'x' ) } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectPacingDelay { nullopt } ); // (the bucket has credit, but the receiver's window is full)
+      test.execute( Receive { { isn + 1001, 1000 } } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 1001 ) );
+      test.execute( ExpectPacingDelay { nullopt } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.congestion_control = TCPConfig::Congestion::None;
+      cfg.pacing = true;
+
+      TCPSenderTestHarness test { "Without congestion control, the receiver's window per RTT", cfg, full };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Tick { 100 } );
+      test.execute( Receive { { isn + 1, 10000 } }.without_push() );
+      test.execute( ExpectPacingRate { 120'000 } ); // 1.2 * 10000 bytes per 100 ms
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.congestion_control = TCPConfig::Congestion::NewReno;
+
+      TCPSenderTestHarness test { "No pacing unless asked for", cfg, full };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Tick { 100 } );
+      test.execute( Receive { { isn + 1, 60000 } }.without_push() );
+      test.execute( ExpectPacingRate { nullopt } );
+      test.execute( Push { string( 4000, 'x' ) } );
+      for ( uint32_t i = 0; i < 4; ++i ) {
+        test.execute( ExpectMessage {} );
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
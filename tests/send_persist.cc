@@ -0,0 +1,113 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+    constexpr TCPSenderTestHarness::FullConfig full {};
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.persist_timer = true;
+      cfg.rt_timeout = 1000;
+      cfg.adaptive_rto = false;
+
+      TCPSenderTestHarness test { "A closed window is probed, less and less often", cfg, full };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Receive { { isn + 1, 0 } }.without_push() );
+      test.execute( Push { "abc" } );
+      test.execute( ExpectNoSegment {} ); // (nothing goes into the closed window)
+
+      // The probes are empty, from just before the ackno, and aren't retransmissions
+      for ( const uint64_t interval : { 1000, 2000, 4000, 8000 } ) {
+        test.execute( Tick { interval - 1 } );
+        test.execute( ExpectNoSegment {} );
+        test.execute( Tick { 1 } );
+        test.execute( ExpectMessage {}.with_seqno( isn ).with_payload_size( 0 ).with_syn( false ) );
+        test.execute( ExpectConsecutiveRetransmissions { 0 } );
+      }
+
+      // A probe's answer opens the window
+      test.execute( Receive { { isn + 1, 1000 } } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 1 ).with_data( "abc" ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 999 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 1 ).with_data( "abc" ) ); // (the RTO, from the start)
+      test.execute( ExpectConsecutiveRetransmissions { 1 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.persist_timer = true;
+      cfg.rt_timeout = 1000;
+      cfg.adaptive_rto = false;
+      cfg.congestion_control = TCPConfig::Congestion::None;
+
+      TCPSenderTestHarness test { "Segments beyond a window that closed wait for it to open", cfg, full };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Receive { { isn + 1, 1000 } }.without_push() );
+      test.execute( Push { "abc" } );
+      test.execute( ExpectMessage {}.with_data( "abc" ) );
+      test.execute( Push { "def" } );
+      test.execute( ExpectMessage {}.with_data( "def" ) );
+      test.execute( Receive { { isn + 4, 0 } }.without_push() );
+
+      // The retransmission timer stops, and the persist timer sends a probe in place of "def"
+      test.execute( Tick { 1000 } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 3 ).with_payload_size( 0 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectConsecutiveRetransmissions { 0 } );
+      test.execute( ExpectSeqnosInFlight { 3 } );
+
+      // A window update (the same ackno) opens it, and the retransmission timer starts over
+      test.execute( Receive { { isn + 4, 1000 } } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 999 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 4 ).with_data( "def" ) );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 1000;
+      cfg.adaptive_rto = false;
+      cfg.persist_timer = false;
+
+      TCPSenderTestHarness test { "Without the persist timer, a byte goes into the closed window", cfg, full };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Receive { { isn + 1, 0 } }.without_push() );
+      test.execute( Push { "abc" } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 1 ).with_data( "a" ) );
+      test.execute( Tick { 1000 } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 1 ).with_data( "a" ) );
+      test.execute( Tick { 1000 } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 1 ).with_data( "a" ) );
+      test.execute( ExpectConsecutiveRetransmissions { 0 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
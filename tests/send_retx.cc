@@ -9,6 +9,15 @@
 
 using namespace std;
 
+namespace {
+struct ExpectBytesBuffered : public ExpectNumber<TCPSender, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "bytes_buffered"; }
+  uint64_t value( const TCPSender& sender ) const override { return sender.reader().bytes_buffered(); }
+};
+} // namespace
+
 int main()
 {
   try {
@@ -198,6 +207,39 @@ int main()
       test.execute( ExpectSeqnosInFlight { 0 } );
       test.execute( HasError { false } );
     }
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      const uint16_t retx_timeout = uniform_int_distribution<uint16_t> { 10, 10000 }( rd );
+      cfg.isn = isn;
+      cfg.rt_timeout = retx_timeout;
+
+      string data;
+      for ( uint32_t i = 0; i < 3000; ++i ) {
+        data.push_back( static_cast<char>( 'a' + i % 26 ) );
+      }
+
+      TCPSenderTestHarness test { "Unacknowledged bytes stay in the outbound stream", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 4000 ) );
+      test.execute( Push { data } );
+      test.execute( ExpectMessage {}.with_data( data.substr( 0, 1000 ) ) );
+      test.execute( ExpectMessage {}.with_data( data.substr( 1000, 1000 ) ) );
+      test.execute( ExpectMessage {}.with_data( data.substr( 2000, 1000 ) ) );
+      test.execute( ExpectBytesBuffered { 3000 } );
+
+      // Half the second segment is acknowledged: it may still need to be resent whole
+      test.execute( AckReceived { Wrap32 { isn + 1501 } }.with_win( 4000 ) );
+      test.execute( ExpectBytesBuffered { 2000 } );
+      test.execute( Tick { retx_timeout } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 1001 ).with_data( data.substr( 1000, 1000 ) ) );
+      test.execute( ExpectNoSegment {} );
+
+      test.execute( AckReceived { Wrap32 { isn + 3001 } }.with_win( 4000 ) );
+      test.execute( ExpectBytesBuffered { 0 } );
+      test.execute( ExpectSeqnosInFlight { 0 } );
+    }
   } catch ( const exception& e ) {
     cerr << e.what() << "\n";
     return 1;
@@ -0,0 +1,177 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+    constexpr TCPSenderTestHarness::FullConfig full {};
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.adaptive_rto = true;
+
+      TCPSenderTestHarness test { "First RTT sample sets the RTO", cfg, full };
+      test.execute( ExpectRTO { 1000 } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_seqno( isn ) );
+      test.execute( Tick { 40 } );
+      test.execute( AckReceived { isn + 1 } );
+      test.execute( ExpectRTO { 120 } ); // SRTT + 4 * RTTVAR = 40 + 4 * 20
+      test.execute( Push { "abc" } );
+      test.execute( ExpectMessage {}.with_data( "abc" ).with_seqno( isn + 1 ) );
+      test.execute( Tick { 119 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_data( "abc" ).with_seqno( isn + 1 ) );
+      test.execute( Tick { 239 } ); // backoff
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_data( "abc" ).with_seqno( isn + 1 ) );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.adaptive_rto = true;
+
+      TCPSenderTestHarness test { "Later samples are smoothed", cfg, full };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Tick { 100 } );
+      test.execute( AckReceived { isn + 1 } );
+      test.execute( ExpectRTO { 300 } );
+      test.execute( Push { "a" } );
+      test.execute( ExpectMessage {}.with_data( "a" ) );
+      test.execute( Tick { 200 } );
+      test.execute( AckReceived { isn + 2 } );
+      test.execute( ExpectRTO { 363 } ); // SRTT = 112.5 ms, RTTVAR = 62.5 ms
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.adaptive_rto = true;
+
+      TCPSenderTestHarness test { "Retransmitted segments give no sample (Karn)", cfg, full };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Tick { 1000 } );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Tick { 5 } );
+      test.execute( AckReceived { isn + 1 } );
+      test.execute( ExpectRTO { 1000 } );
+      test.execute( Push { "a" } );
+      test.execute( ExpectMessage {}.with_data( "a" ) );
+      test.execute( Tick { 999 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_data( "a" ) );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.adaptive_rto = true;
+      cfg.timestamps = true;
+
+      TCPSenderTestHarness test { "Echoed timestamps give samples, even of retransmissions", cfg, full };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_timestamp( 0 ) );
+      test.execute( Tick { 1000 } );
+      test.execute( ExpectMessage {}.with_syn( true ).with_timestamp( 1000 ) );
+      test.execute( Tick { 40 } );
+      test.execute( AckReceived { isn + 1 }.with_timestamp_echo( 1000 ) );
+      test.execute( ExpectRTO { 120 } ); // (the retransmission's 40 ms, not the 1040 ms since the first SYN)
+      test.execute( Push { "abc" } );
+      test.execute( ExpectMessage {}.with_data( "abc" ).with_timestamp( 1040 ) );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.adaptive_rto = true;
+      cfg.rto_min = 50;
+      cfg.rto_max = 3000;
+
+      TCPSenderTestHarness test { "RTO stays within its bounds", cfg, full };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Tick { 1000 } );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Tick { 2000 } );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Tick { 2999 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } ); // capped at rto_max rather than doubled to 4000 ms
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Tick { 3000 } );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+
+      test.execute( AckReceived { isn + 1 } );
+      test.execute( Push { "a" } );
+      test.execute( ExpectMessage {}.with_data( "a" ) );
+      test.execute( Tick { 1 } );
+      test.execute( AckReceived { isn + 2 } );
+      test.execute( ExpectRTO { 50 } ); // 3 ms, raised to rto_min
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.adaptive_rto = true;
+
+      TCPSenderTestHarness test { "Loss on a 1 ms path is recovered in milliseconds", cfg, full };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Tick { 1 } );
+      test.execute( AckReceived { isn + 1 } );
+      for ( uint32_t i = 0; i < 10; ++i ) {
+        test.execute( Push { "x" } );
+        test.execute( ExpectMessage {}.with_seqno( isn + 1 + i ) );
+        test.execute( Tick { 1 } );
+        test.execute( AckReceived { isn + 2 + i } );
+      }
+      test.execute( ExpectRTO { cfg.rto_min } );
+      test.execute( Push { "lost" } );
+      test.execute( ExpectMessage {}.with_data( "lost" ) );
+      test.execute( Tick { cfg.rto_min - 1 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_data( "lost" ) );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.adaptive_rto = false;
+
+      TCPSenderTestHarness test { "Fixed RTO when adaptive RTO is off", cfg, full };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Tick { 40 } );
+      test.execute( AckReceived { isn + 1 } );
+      test.execute( ExpectRTO { 1000 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
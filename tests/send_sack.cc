@@ -0,0 +1,151 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+// An ACK of isn + `ackno` that also SACKs the given ranges (as offsets from the ISN)
+Receive SACK( Wrap32 isn, uint32_t ackno, const vector<pair<uint32_t, uint32_t>>& blocks )
+{
+  TCPReceiverMessage msg { isn + ackno, 60000 };
+  for ( const auto& [begin, end] : blocks ) {
+    msg.SACK_blocks.push_back( { isn + begin, isn + end } );
+  }
+  return Receive { msg };
+}
+
+// Connect, and send six segments (at isn+1, isn+1001, ..., isn+5001), of which the receiver gets all but the
+// second and the fourth (and says so).
+void lose_two_of_six( TCPSenderTestHarness& test, Wrap32 isn )
+{
+  test.execute( Push {} );
+  test.execute( ExpectMessage {}.with_syn( true ).with_SACK_permitted( true ) );
+  test.execute( Receive { { isn + 1, 60000 } }.without_push() );
+  test.execute( Push { string( 6000, 'x' ) } );
+  for ( uint32_t i = 0; i < 6; ++i ) {
+    test.execute( ExpectMessage {}.with_seqno( isn + 1 + 1000 * i ) );
+  }
+
+  test.execute( SACK( isn, 1001, {} ) );
+  test.execute( SACK( isn, 1001, { { 2001, 3001 } } ) );
+  test.execute( SACK( isn, 1001, { { 4001, 5001 }, { 2001, 3001 } } ) );
+  test.execute( ExpectNoSegment {} );
+}
+} // namespace
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+    constexpr TCPSenderTestHarness::FullConfig full {};
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.fast_retransmit = true;
+      cfg.sack = true;
+      cfg.congestion_control = TCPConfig::Congestion::None;
+
+      TCPSenderTestHarness test { "Fast recovery resends every hole, and only the holes", cfg, full };
+      lose_two_of_six( test, isn );
+      test.execute( SACK( isn, 1001, { { 4001, 6001 }, { 2001, 3001 } } ) );
+      test.execute( ExpectMessage {}.with_seqno( isn + 1001 ) );
+      test.execute( ExpectMessage {}.with_seqno( isn + 3001 ) );
+      test.execute( ExpectNoSegment {} );
+
+      // The first hole's retransmission arrives: the second was already resent, and the rest SACKed
+      test.execute( SACK( isn, 3001, { { 4001, 6001 } } ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( SACK( isn, 6001, {} ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSeqnosInFlight { 0 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.fast_retransmit = true;
+      cfg.congestion_control = TCPConfig::Congestion::None;
+      cfg.sack = false;
+
+      TCPSenderTestHarness test { "Without SACK, a hole per partial ACK", cfg, full };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_SACK_permitted( false ) );
+      test.execute( Receive { { isn + 1, 60000 } }.without_push() );
+      test.execute( Push { string( 6000, 'x' ) } );
+      for ( uint32_t i = 0; i < 6; ++i ) {
+        test.execute( ExpectMessage {}.with_seqno( isn + 1 + 1000 * i ) );
+      }
+      for ( uint32_t i = 0; i < 4; ++i ) {
+        test.execute( SACK( isn, 1001, { { 2001, 3001 } } ) ); // (ignored)
+      }
+      test.execute( ExpectMessage {}.with_seqno( isn + 1001 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( SACK( isn, 3001, {} ) );
+      test.execute( ExpectMessage {}.with_seqno( isn + 3001 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.fast_retransmit = true;
+      cfg.sack = true;
+      cfg.congestion_control = TCPConfig::Congestion::NewReno;
+
+      TCPSenderTestHarness test { "SACKed segments leave room in the window", cfg, full };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Receive { { isn + 1, 60000 } }.without_push() );
+      test.execute( Push { string( 4000, 'x' ) } );
+      for ( uint32_t i = 0; i < 4; ++i ) {
+        test.execute( ExpectMessage {}.with_seqno( isn + 1 + 1000 * i ) );
+      }
+
+      // The first segment is lost. Recovery halves cwnd to 2000; the three SACKed segments are out of the
+      // network, so the retransmission and one new segment fit.
+      test.execute( Push { string( 4000, 'y' ) } );
+      test.execute( SACK( isn, 1, { { 1001, 2001 } } ) );
+      test.execute( SACK( isn, 1, { { 1001, 3001 } } ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( SACK( isn, 1, { { 1001, 4001 } } ) );
+      test.execute( ExpectMessage {}.with_seqno( isn + 1 ) );
+      test.execute( ExpectMessage {}.with_seqno( isn + 4001 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.fast_retransmit = true;
+      cfg.sack = true;
+
+      TCPSenderTestHarness test { "Blocks outside what was sent are ignored", cfg, full };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Receive { { isn + 1, 60000 } }.without_push() );
+      test.execute( Push { string( 2000, 'x' ) } );
+      test.execute( ExpectMessage {} );
+      test.execute( ExpectMessage {} );
+      test.execute( SACK( isn, 1, { { 1001, 9001 }, { 500, 100 } } ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSeqnosInFlight { 2000 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -58,6 +58,16 @@ public:
                    { TCPSender { ByteStream { config.send_capacity }, config.isn, config.rt_timeout } } )
   {}
 
+  // A sender constructed from the whole TCPConfig, with the features it turns on
+  struct FullConfig
+  {};
+  TCPSenderTestHarness( std::string name, const TCPConfig& config, FullConfig /* unused */ )
+    : TestHarness( move( name ),
+                   "initial_RTO_ms=" + to_string( config.rt_timeout ) + " and ISN=" + to_string( config.isn )
+                     + " (full config)",
+                   { TCPSender { ByteStream { config.send_capacity }, config } } )
+  {}
+
   template<std::derived_from<TestStep<TCPSender>> T>
   void execute( const T& test )
   {
@@ -82,6 +92,13 @@ struct ExpectSeqno : public ExpectNumber<TCPSender, Wrap32>
   }
 };
 
+struct ExpectRTO : public ExpectNumber<TCPSender, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "RTO_ms"; }
+  uint64_t value( const TCPSender& sender ) const override { return sender.RTO_ms(); }
+};
+
 struct ExpectReset : public ExpectBool<TCPSender>
 {
   using ExpectBool::ExpectBool;
@@ -217,27 +234,44 @@ struct Receive : public Action<SenderAndOutput>
 {
   TCPReceiverMessage msg_;
   bool push_ = true;
+  bool pure_ACK_ = true;
 
   explicit Receive( TCPReceiverMessage msg ) : msg_( msg ) {}
   std::string description() const override
   {
     std::ostringstream desc;
-    desc << "receive(ack=" << to_string( msg_.ackno ) << ", win=" << msg_.window_size << ")";
+    desc << "receive(ack=" << to_string( msg_.ackno ) << ", win=" << msg_.window_size;
+    if ( msg_.timestamp_echo.has_value() ) {
+      desc << ", TSecr=" << *msg_.timestamp_echo;
+    }
+    for ( const auto& [begin, end] : msg_.SACK_blocks ) {
+      desc << ", SACK=" << begin << "-" << end;
+    }
+    desc << ")";
+    if ( not pure_ACK_ ) {
+      desc << " on a data segment";
+    }
     if ( push_ ) {
       desc << ", then push";
     }
     return desc.str();
   }
 
-  Receive& with_win( uint16_t win )
+  Receive& with_win( uint32_t win )
   {
     msg_.window_size = win;
     return *this;
   }
 
+  Receive& with_timestamp_echo( uint32_t echo )
+  {
+    msg_.timestamp_echo = echo;
+    return *this;
+  }
+
   void execute( SenderAndOutput& ss ) const override
   {
-    ss.sender.receive( msg_ );
+    ss.sender.receive( msg_, pure_ACK_ );
     if ( push_ ) {
       ss.sender.push( ss.make_transmit() );
     }
@@ -249,6 +283,12 @@ struct Receive : public Action<SenderAndOutput>
     return *this;
   }
 
+  Receive& on_data_segment()
+  {
+    pure_ACK_ = false;
+    return *this;
+  }
+
   constexpr std::string obj() const override { return "TCPSender"; }
 };
 
@@ -283,8 +323,13 @@ struct ExpectMessage : public Expectation<SenderAndOutput>
   std::optional<Wrap32> seqno {};
   std::optional<std::string> data {};
   std::optional<size_t> payload_size {};
+  std::optional<bool> sack_permitted {};
+  std::optional<uint32_t> timestamp {};
 
-  bool empty() const { return not( syn or fin or rst or seqno or data or payload_size ); }
+  bool empty() const
+  {
+    return not( syn or fin or rst or seqno or data or payload_size or sack_permitted or timestamp );
+  }
 
   ExpectMessage& with_syn( bool syn_ )
   {
@@ -310,6 +355,18 @@ struct ExpectMessage : public Expectation<SenderAndOutput>
     return *this;
   }
 
+  ExpectMessage& with_SACK_permitted( bool sack_permitted_ )
+  {
+    sack_permitted = sack_permitted_;
+    return *this;
+  }
+
+  ExpectMessage& with_timestamp( uint32_t timestamp_ )
+  {
+    timestamp = timestamp_;
+    return *this;
+  }
+
   ExpectMessage& with_seqno( Wrap32 seqno_ )
   {
     seqno = seqno_;
@@ -361,6 +418,12 @@ struct ExpectMessage : public Expectation<SenderAndOutput>
     if ( rst.has_value() ) {
       o << ( rst.value() ? " +RST" : " -RST" );
     }
+    if ( sack_permitted.has_value() ) {
+      o << ( sack_permitted.value() ? " +SACK_PERMITTED" : " -SACK_PERMITTED" );
+    }
+    if ( timestamp.has_value() ) {
+      o << " TS=" << timestamp.value();
+    }
     return o.str();
   }
 
@@ -391,6 +454,12 @@ struct ExpectMessage : public Expectation<SenderAndOutput>
     if ( rst.has_value() and seg.RST != rst.value() ) {
       throw MessageExpectationViolation( seg, "RST flag", rst.value(), seg.RST );
     }
+    if ( sack_permitted.has_value() and seg.SACK_permitted != sack_permitted.value() ) {
+      throw MessageExpectationViolation( seg, "SACK-permitted flag", sack_permitted.value(), seg.SACK_permitted );
+    }
+    if ( timestamp.has_value() and seg.timestamp != timestamp ) {
+      throw MessageExpectationViolation( seg, "timestamp", timestamp, seg.timestamp );
+    }
     if ( seqno.has_value() and seg.seqno != seqno.value() ) {
       throw MessageExpectationViolation( seg, "sequence number", seqno.value(), seg.seqno );
     }
@@ -0,0 +1,207 @@
+#include "tcp_config.hh"
+#include "tcp_receiver.hh"
+#include "tcp_sender.hh"
+
+#include <cstddef>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+// Flows of TCPSender -> TCPReceiver sharing one bottleneck link (with a drop-tail queue, a propagation delay, and
+// random loss), simulated a millisecond at a time. ACKs come back over an uncongested, lossless path.
+namespace {
+constexpr uint64_t bottleneck_bytes_per_ms = 2500; // 20 Mbit/s
+constexpr uint64_t one_way_delay_ms = 10;
+constexpr uint64_t default_queue_limit = 50'000; // bytes (about 1 BDP)
+constexpr uint64_t shallow_queue_limit = 5'000;
+constexpr uint64_t header_size = 40;
+constexpr uint64_t duration_ms = 30'000;
+
+struct Flow
+{
+  TCPSender sender;
+  TCPReceiver receiver;
+  deque<pair<uint64_t, TCPReceiverMessage>> acks_in_flight {}; // (arrival time, message)
+  uint64_t payload_bytes_sent {};
+};
+
+struct Result
+{
+  double utilization;
+  double fairness;
+  double retransmitted;
+  double redundant; // bytes sent again that the receiver already had
+  uint64_t timeouts;
+  uint64_t tail_drops; // segments that found the bottleneck queue full
+};
+
+TCPConfig config( TCPConfig::Congestion algorithm, bool sack = true, bool pacing = false )
+{
+  TCPConfig cfg;
+  cfg.adaptive_rto = true;
+  cfg.congestion_control = algorithm;
+  cfg.fast_retransmit = true;
+  cfg.sack = sack;
+  cfg.pacing = pacing;
+  return cfg;
+}
+
+Result run( string_view name,
+            const TCPConfig& cfg,
+            size_t num_flows,
+            double loss_rate,
+            uint64_t queue_limit = default_queue_limit )
+{
+  vector<Flow> flows;
+  for ( size_t i = 0; i < num_flows; ++i ) {
+    flows.push_back(
+      { TCPSender { ByteStream { cfg.send_capacity }, cfg }, TCPReceiver { Reassembler { ByteStream { 64000 } } } } );
+  }
+
+  default_random_engine rd { 6298 };
+  bernoulli_distribution lost { loss_rate };
+  deque<pair<size_t, TCPSenderMessage>> queue; // at the bottleneck
+  uint64_t queued_bytes = 0;
+  deque<tuple<uint64_t, size_t, TCPSenderMessage>> propagating; // (arrival time, flow, message)
+  uint64_t credit = 0;                                           // bytes the bottleneck may send now
+  uint64_t timeouts = 0;
+  uint64_t tail_drops = 0;
+  const string filler( cfg.send_capacity, 'x' );
+
+  for ( uint64_t now = 0; now < duration_ms; ++now ) {
+    for ( size_t i = 0; i < flows.size(); ++i ) {
+      Flow& flow = flows[i];
+      const auto transmit = [&]( const TCPSenderMessage& msg ) {
+        flow.payload_bytes_sent += msg.payload.size();
+        const uint64_t size = msg.payload.size() + header_size;
+        if ( queued_bytes + size > queue_limit ) {
+          tail_drops++;
+        } else if ( not lost( rd ) ) {
+          queue.emplace_back( i, msg );
+          queued_bytes += size;
+        }
+      };
+
+      // Deliver ACKs, keep the outbound stream full, and let the sender send and time out
+      while ( not flow.acks_in_flight.empty() and flow.acks_in_flight.front().first <= now ) {
+        flow.sender.receive( flow.acks_in_flight.front().second );
+        flow.acks_in_flight.pop_front();
+      }
+      flow.sender.writer().push( filler.substr( 0, flow.sender.writer().available_capacity() ) );
+      flow.sender.push( transmit );
+      const auto retransmissions = flow.sender.consecutive_retransmissions();
+      flow.sender.tick( 1, transmit );
+      timeouts += flow.sender.consecutive_retransmissions() > retransmissions;
+    }
+
+    // The bottleneck
+    credit = min( credit + bottleneck_bytes_per_ms, 2 * bottleneck_bytes_per_ms );
+    while ( not queue.empty() and queue.front().second.payload.size() + header_size <= credit ) {
+      const uint64_t size = queue.front().second.payload.size() + header_size;
+      credit -= size;
+      queued_bytes -= size;
+      propagating.emplace_back( now + one_way_delay_ms, queue.front().first, move( queue.front().second ) );
+      queue.pop_front();
+    }
+    if ( queue.empty() ) {
+      credit = min( credit, bottleneck_bytes_per_ms ); // (an idle link doesn't save up)
+    }
+
+    // Receivers
+    while ( not propagating.empty() and get<0>( propagating.front() ) <= now ) {
+      Flow& flow = flows[get<1>( propagating.front() )];
+      flow.receiver.receive( move( get<2>( propagating.front() ) ) );
+      flow.receiver.reader().pop( flow.receiver.reader().bytes_buffered() );
+      flow.acks_in_flight.emplace_back( now + one_way_delay_ms, flow.receiver.send() );
+      propagating.pop_front();
+    }
+  }
+
+  double total = 0;
+  double sum_of_squares = 0;
+  uint64_t sent = 0;
+  uint64_t duplicates = 0;
+  for ( const auto& flow : flows ) {
+    const auto goodput = static_cast<double>( flow.receiver.writer().bytes_pushed() );
+    total += goodput;
+    sum_of_squares += goodput * goodput;
+    sent += flow.payload_bytes_sent;
+    duplicates += flow.receiver.reassembly_stats().duplicate_bytes;
+  }
+
+  const Result result { total / static_cast<double>( bottleneck_bytes_per_ms * duration_ms ),
+                        total * total / ( static_cast<double>( flows.size() ) * sum_of_squares ),
+                        static_cast<double>( sent ) / total - 1,
+                        static_cast<double>( duplicates ) / total,
+                        timeouts,
+                        tail_drops };
+
+  cout << "Congestion control (" << name << ", " << num_flows << " flows, " << loss_rate * 100 << "% loss, "
+       << queue_limit << "-byte queue) reached " << fixed << setprecision( 2 ) << result.utilization * 100
+       << "% utilization with fairness " << setprecision( 3 ) << result.fairness << " ("
+       << setprecision( 1 ) << result.retransmitted * 100 << "% of bytes sent again, "
+       << setprecision( 2 ) << result.redundant * 100 << "% redundantly, " << result.timeouts << " timeouts, "
+       << result.tail_drops << " tail drops).\n";
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+  debug_output << "        " << left << setw( 17 ) << name << right << num_flows << " flows, " << setw( 4 )
+               << loss_rate * 100 << "% loss, " << setw( 5 ) << queue_limit << "B queue: " << fixed << setprecision( 1 ) << setw( 5 )
+               << result.utilization * 100 << "% utilization, fairness " << setprecision( 3 ) << result.fairness
+               << ", " << setprecision( 1 ) << result.retransmitted * 100 << "% resent ("
+               << setprecision( 2 ) << result.redundant * 100 << "% redundantly), " << setw( 4 ) << result.timeouts
+               << " timeouts, " << setw( 4 ) << result.tail_drops << " tail drops\n";
+
+  return result;
+}
+
+void program_body()
+{
+  for ( const double loss_rate : { 0.0, 0.001, 0.01 } ) {
+    run( "none", config( TCPConfig::Congestion::None ), 2, loss_rate );
+    run( "NewReno (no SACK)", config( TCPConfig::Congestion::NewReno, false ), 2, loss_rate );
+    for ( const auto& [name, cfg] : { pair { "NewReno", config( TCPConfig::Congestion::NewReno ) },
+                                      pair { "CUBIC", config( TCPConfig::Congestion::Cubic ) },
+                                      pair { "CUBIC (paced)", config( TCPConfig::Congestion::Cubic, true, true ) } } ) {
+      const auto result = run( name, cfg, 2, loss_rate );
+      if ( loss_rate == 0 and result.fairness < 0.8 ) {
+        throw runtime_error( string( name ) + " shared the bottleneck unfairly" );
+      }
+      if ( loss_rate == 0 and result.utilization < 0.5 ) {
+        throw runtime_error( string( name ) + " left the bottleneck mostly idle" );
+      }
+      if ( result.timeouts > 50 ) {
+        throw runtime_error( string( name ) + " waited for the RTO to repair " + to_string( result.timeouts )
+                             + " losses (rather than retransmitting on duplicate ACKs)" );
+      }
+    }
+  }
+
+  // A shallow buffer overflows on bursts, which pacing spreads out
+  const auto bursty = run( "CUBIC", config( TCPConfig::Congestion::Cubic ), 2, 0, shallow_queue_limit );
+  const auto paced
+    = run( "CUBIC (paced)", config( TCPConfig::Congestion::Cubic, true, true ), 2, 0, shallow_queue_limit );
+  if ( paced.tail_drops > bursty.tail_drops ) {
+    throw runtime_error( "pacing overflowed the shallow queue more often (" + to_string( paced.tail_drops )
+                         + " tail drops, rather than " + to_string( bursty.tail_drops ) + ")" );
+  }
+}
+} // namespace
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,129 @@
+#include "common.hh"
+#include "helpers.hh"
+#include "random.hh"
+#include "tcp_minnow_socket_impl.hh"
+
+#include <array>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+// TCP-over-IPv4 datagrams, over one end of a Unix datagram socket pair (in place of a TUN device)
+class DatagramPairAdapter : public TCPOverIPv4Adapter
+{
+  FileDescriptor fd_;
+
+public:
+  explicit DatagramPairAdapter( FileDescriptor&& fd ) : fd_( move( fd ) ) {}
+
+  optional<TCPMessage> read( string payload_buffer )
+  {
+    vector<string> strs( 3 );
+    strs[0].resize( IPv4Header::LENGTH );
+    strs[1].resize( TCPSegment::HEADER_LENGTH );
+    strs[2] = move( payload_buffer );
+    fd_.read( strs );
+
+    InternetDatagram ip_dgram;
+    if ( parse( ip_dgram, move( strs ) ) ) {
+      return unwrap_tcp_in_ip( move( ip_dgram ) );
+    }
+    return {};
+  }
+
+  void write( const TCPMessage& seg ) { fd_.write( serialize( wrap_tcp_in_ip( seg ) ) ); }
+
+  FileDescriptor& fd() { return fd_; }
+};
+
+using Socket = TCPMinnowSocket<DatagramPairAdapter>;
+
+void wait_for( FileDescriptor& event )
+{
+  pollfd pfd { event.fd_num(), POLLIN, 0 };
+  while ( ::poll( &pfd, 1, 1000 ) != 1 ) {}
+}
+
+// Send `data` through a connection between two sockets that use in-process streams, and return what arrives
+string transfer( const string& data )
+{
+  array<int, 2> fds {};
+  CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_DGRAM, 0, fds.data() ) );
+  Socket a { DatagramPairAdapter { FileDescriptor { fds[0] } } };
+  Socket b { DatagramPairAdapter { FileDescriptor { fds[1] } } };
+  a.use_in_process_streams();
+  b.use_in_process_streams();
+
+  // (A short RTO, so that the socket that closes first doesn't linger for long.)
+  TCPConfig cfg;
+  cfg.rt_timeout = 10;
+  FdAdapterConfig a_ad;
+  a_ad.source = Address { "10.0.0.1", 1234 };
+  a_ad.destination = Address { "10.0.0.2", 5678 };
+  FdAdapterConfig b_ad;
+  b_ad.source = Address { "10.0.0.2", 5678 };
+
+  thread listener { [&] { b.listen_and_accept( cfg, b_ad ); } };
+  a.connect( cfg, a_ad );
+  listener.join();
+
+  string received;
+  thread reader { [&] {
+    SPSCReader& in = b.inbound_reader();
+    while ( not in.is_finished() and not in.has_error() ) {
+      wait_for( in.readable_event() );
+      while ( in.bytes_buffered() > 0 ) {
+        const auto view = in.peek();
+        received += view;
+        in.pop( view.size() );
+      }
+      in.acknowledge_event();
+    }
+  } };
+
+  SPSCWriter& out = a.outbound_writer();
+  string_view remaining = data;
+  while ( not remaining.empty() ) {
+    remaining.remove_prefix( out.push( remaining ) );
+    if ( not remaining.empty() ) {
+      out.acknowledge_event();
+      wait_for( out.writable_event() );
+    }
+  }
+  out.close();
+
+  reader.join();
+  check( not b.inbound_reader().has_error(), "the inbound stream finished cleanly" );
+  b.wait_until_closed();
+  a.wait_until_closed();
+  return received;
+}
+} // namespace
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+    string data( 1'000'000, 0 );
+    for ( auto& ch : data ) {
+      ch = static_cast<char>( rd() );
+    }
+
+    check( transfer( data ) == data, "the bytes arrive, in order, through the in-process streams" );
+    check( transfer( "" ).empty(), "an empty stream just finishes" );
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
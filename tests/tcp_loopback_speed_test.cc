@@ -0,0 +1,102 @@
+#include "allocation_counter.hh"
+#include "tcp_peer_pair.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+// Two TCPPeers connected back to back in memory, one sending `input_len` bytes to the other. The transmit
+// functions are handed to the peers either as lambdas or as std::functions (TCPPeer::TransmitFunction).
+// (Vector links, which keep their storage from one pass to the next.)
+template<bool type_erased>
+double speed_test( fstream& debug_output, const size_t input_len, string_view description )
+{
+  TCPConfig cfg;
+  cfg.send_capacity = 1 << 20;
+  cfg.recv_capacity = 1 << 20;
+  cfg.window_scaling = true; // (so that all of recv_capacity can be advertised)
+  TCPPeerPair<vector<TCPMessage>> c { cfg, cfg };
+  TCPPeer& a = c.a;
+  TCPPeer& b = c.b;
+
+  // (Copying the message, as a link would, is the same either way.)
+  using Transmit = conditional_t<type_erased, TCPPeer::TransmitFunction, decltype( c.to_b() )>;
+  const Transmit to_b = c.to_b();
+  const Transmit to_a = c.to_a();
+
+  const string chunk( 1 << 16, 'x' );
+  uint64_t segments = 0;
+
+  const auto start_allocations = allocation_count();
+  const auto start_time = steady_clock::now();
+  while ( b.inbound_reader().bytes_popped() < input_len ) {
+    const auto remaining = input_len - a.outbound_writer().bytes_pushed();
+    a.outbound_writer().push( chunk.substr( 0, min( remaining, a.outbound_writer().available_capacity() ) ) );
+    a.push( to_b );
+
+    segments += c.a_to_b.size();
+    for ( auto& msg : c.a_to_b ) {
+      b.receive( move( msg ), to_a );
+    }
+    c.a_to_b.clear();
+    b.inbound_reader().pop( b.inbound_reader().bytes_buffered() );
+    for ( auto& msg : c.b_to_a ) {
+      a.receive( move( msg ), to_b );
+    }
+    c.b_to_a.clear();
+    a.tick( 1, to_b );
+  }
+
+  const auto stop_time = steady_clock::now();
+  const auto allocations = allocation_count() - start_allocations;
+
+  const auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+  const auto gigabits_per_second = 8 * static_cast<double>( input_len ) / test_duration.count() / 1e9;
+  const auto allocations_per_segment
+    = static_cast<double>( allocations.allocations ) / static_cast<double>( max<uint64_t>( segments, 1 ) );
+
+  cout << "TCPPeer loopback (transmit as " << description << ") reached " << fixed << setprecision( 2 )
+       << gigabits_per_second << " Gbit/s (" << segments << " segments, " << allocations_per_segment
+       << " heap allocations per segment).\n";
+
+  debug_output << "        TCPPeer loopback, transmit as " << left << setw( 13 ) << description << right << fixed
+               << setprecision( 2 ) << setw( 5 ) << gigabits_per_second << " Gbit/s, " << allocations_per_segment
+               << " allocations/segment\n";
+
+  if ( gigabits_per_second < 0.1 ) {
+    throw runtime_error( "TCPPeer loopback did not meet minimum speed of 0.1 Gbit/s" );
+  }
+
+  return gigabits_per_second;
+}
+
+void program_body()
+{
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  speed_test<true>( debug_output, 1e8, "std::function" );
+  speed_test<false>( debug_output, 1e8, "lambda" );
+}
+} // namespace
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
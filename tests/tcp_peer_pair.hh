@@ -0,0 +1,111 @@
+#pragma once
+
+#include "helpers.hh"
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+#include "tcp_segment.hh"
+
+#include <cstdint>
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+// Two TCPPeers, `a` and `b`, connected back to back by in-memory links. Each link holds the messages in flight
+// one way, copied as a real link would copy them (the sender reuses its buffers), into payload buffers from the
+// receiving peer's inbound stream -- as TCPMinnowSocket reads each segment. With `serialized`, each message is
+// also serialized as a segment and parsed back, so that its options go through their encoding.
+template<typename Link = std::deque<TCPMessage>>
+struct TCPPeerPair
+{
+  TCPPeer a;
+  TCPPeer b;
+  Link a_to_b {};
+  Link b_to_a {};
+  bool serialized {};
+
+  TCPPeerPair( const TCPConfig& a_cfg, const TCPConfig& b_cfg ) : a( a_cfg ), b( b_cfg ) {}
+
+  // A configuration with the given ISN, and otherwise the defaults
+  static TCPConfig config( uint32_t isn )
+  {
+    TCPConfig cfg;
+    cfg.isn = Wrap32 { isn };
+    return cfg;
+  }
+
+  // Transmit functions that put each message on the link to the other peer
+  auto to_b() { return to( a_to_b, b ); }
+  auto to_a() { return to( b_to_a, a ); }
+
+  // Deliver everything in flight one way (the replies go on the other link)
+  void deliver_to_b() { deliver( a_to_b, b, to_a() ); }
+  void deliver_to_a() { deliver( b_to_a, a, to_b() ); }
+
+  // Deliver everything in flight, one way and then the other
+  void round_trip()
+  {
+    deliver_to_b();
+    deliver_to_a();
+  }
+
+  // Deliver what is in flight both ways at once: neither peer's replies go out before it has received
+  void cross()
+  {
+    auto to_b_now = std::exchange( a_to_b, {} );
+    auto to_a_now = std::exchange( b_to_a, {} );
+    deliver( to_b_now, b, to_a() );
+    deliver( to_a_now, a, to_b() );
+  }
+
+  // Open the connection (a connecting to b), and leave it idle
+  void connect()
+  {
+    a.push( to_b() );
+    for ( int i = 0; i < 3; ++i ) {
+      round_trip();
+    }
+  }
+
+  bool idle() const { return a_to_b.empty() and b_to_a.empty(); }
+
+private:
+  auto to( Link& link, TCPPeer& receiver )
+  {
+    return [this, &link, &receiver]( const TCPMessage& msg ) { link.push_back( copy( msg, receiver ) ); };
+  }
+
+  static void deliver( Link& link, TCPPeer& receiver, const auto& transmit )
+  {
+    for ( auto& msg : link ) {
+      receiver.receive( std::move( msg ), transmit );
+    }
+    link.clear();
+  }
+
+  TCPMessage copy( const TCPMessage& msg, TCPPeer& receiver ) const
+  {
+    if ( serialized ) {
+      TCPSegment segment { .message = { msg.sender.borrow(), msg.receiver.borrow() } };
+      segment.compute_checksum( 0 );
+      TCPSegment parsed;
+      if ( not parse( parsed, serialize( segment ), 0 ) ) {
+        throw std::runtime_error( "segment did not parse: " + segment.to_string() );
+      }
+      return std::move( parsed.message );
+    }
+
+    const TCPSenderMessage& sender = msg.sender.get();
+    std::string payload = receiver.inbound_reader().chunk_pool().take( sender.payload.size() );
+    payload.assign( sender.payload );
+    return { TCPSenderMessage { sender.seqno,
+                                sender.SYN,
+                                std::move( payload ),
+                                sender.FIN,
+                                sender.RST,
+                                sender.SACK_permitted,
+                                sender.window_scale,
+                                sender.timestamp },
+             TCPReceiverMessage { msg.receiver.get() } };
+  }
+};
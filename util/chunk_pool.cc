@@ -0,0 +1,71 @@
+#include "chunk_pool.hh"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+using namespace std;
+
+ChunkPool::ChunkPool( size_t chunk_size, size_t max_free ) : chunk_size_( chunk_size ), max_free_( max_free )
+{
+  free_.reserve( max_free_ );
+}
+
+ChunkPool::ChunkPool( const ChunkPool& other ) : ChunkPool( other.chunk_size_, other.max_free_ ) {}
+
+ChunkPool& ChunkPool::operator=( const ChunkPool& other )
+{
+  if ( this != &other ) {
+    *this = ChunkPool { other.chunk_size_, other.max_free_ };
+  }
+  return *this;
+}
+
+string ChunkPool::take( size_t min_capacity )
+{
+  // most recently returned first, since its memory is the most likely to still be in cache
+  for ( auto it = free_.rbegin(); it != free_.rend(); ++it ) {
+    if ( it->capacity() >= min_capacity ) {
+      ++chunks_reused_;
+      bytes_free_ -= it->capacity();
+      string chunk = move( *it );
+      free_.erase( next( it ).base() );
+      return chunk;
+    }
+  }
+
+  ++chunks_allocated_;
+  string chunk;
+  chunk.reserve( max( chunk_size_, min_capacity ) );
+  return chunk;
+}
+
+void ChunkPool::give( string chunk )
+{
+  if ( chunk.capacity() < chunk_size_ or chunk.capacity() > kMaxChunkSize ) {
+    return;
+  }
+
+  chunk.clear();
+  if ( free_.size() < max_free_ ) {
+    bytes_free_ += chunk.capacity();
+    free_.push_back( move( chunk ) );
+  } else {
+    // Full: keep the larger buffer, since a small request can use any of them but a large one can't
+    auto smallest = min_element(
+      free_.begin(), free_.end(), []( const string& a, const string& b ) { return a.capacity() < b.capacity(); } );
+    if ( smallest->capacity() >= chunk.capacity() ) {
+      return;
+    }
+    bytes_free_ += chunk.capacity() - smallest->capacity();
+    *smallest = move( chunk );
+  }
+
+  // Over the byte budget: drop the oldest (least likely to be in cache)
+  auto oldest = free_.begin();
+  while ( bytes_free_ > kMaxFreeBytes ) {
+    bytes_free_ -= oldest->capacity();
+    ++oldest;
+  }
+  free_.erase( free_.begin(), oldest );
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// A ChunkPool keeps a free list of string buffers of at least a fixed size, so that code that keeps building
+// and dropping strings (e.g. segment payloads on their way into a ByteStream) can recycle the heap blocks
+// instead of handing them back to malloc and asking for new ones. It keeps at most kMaxFreeBytes of them, and
+// none larger than kMaxChunkSize (so that one large string can't stay pinned for the life of its owner).
+class ChunkPool
+{
+public:
+  static constexpr size_t kDefaultChunkSize = 1024;
+  static constexpr size_t kDefaultMaxFree = 64; // (a burst of segments' payloads is taken before any return)
+  static constexpr size_t kMaxChunkSize = 64 * 1024;
+  static constexpr size_t kMaxFreeBytes = 1024 * 1024;
+
+  explicit ChunkPool( size_t chunk_size = kDefaultChunkSize, size_t max_free = kDefaultMaxFree );
+
+  // A copy has the same settings but starts with an empty free list (the free buffers aren't state)
+  ChunkPool( const ChunkPool& other );
+  ChunkPool& operator=( const ChunkPool& other );
+  ChunkPool( ChunkPool&& other ) noexcept = default;
+  ChunkPool& operator=( ChunkPool&& other ) noexcept = default;
+  ~ChunkPool() = default;
+
+  // An empty string with capacity() >= max(chunk_size(), min_capacity): a recycled buffer if a big enough one
+  // is free, otherwise a new one.
+  std::string take( size_t min_capacity = 0 );
+
+  // Return a string to the pool. Its contents are discarded; its buffer is kept if it is at least
+  // chunk_size() and at most kMaxChunkSize bytes (when the free list is full, in place of the smallest free
+  // buffer if it is larger), and evicts the oldest free buffers if they would then hold over kMaxFreeBytes.
+  void give( std::string chunk );
+
+  size_t chunk_size() const { return chunk_size_; }
+  size_t chunks_free() const { return free_.size(); }
+  size_t bytes_free() const { return bytes_free_; } // capacity of the free buffers
+  size_t chunks_allocated() const { return chunks_allocated_; } // take() calls that needed a new buffer
+  size_t chunks_reused() const { return chunks_reused_; }       // take() calls served from the free list
+
+private:
+  size_t chunk_size_;
+  size_t max_free_;
+  std::vector<std::string> free_ {};
+  size_t bytes_free_ {};
+  size_t chunks_allocated_ {};
+  size_t chunks_reused_ {};
+};
@@ -0,0 +1,22 @@
+#include "event_fd.hh"
+#include "exception.hh"
+
+#include <cstdint>
+#include <string>
+#include <sys/eventfd.h>
+
+using namespace std;
+
+EventFD::EventFD() : FileDescriptor( ::CheckSystemCall( "eventfd", eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC ) ) ) {}
+
+void EventFD::notify()
+{
+  const uint64_t one = 1;
+  write( string_view { reinterpret_cast<const char*>( &one ), sizeof( one ) } ); // NOLINT(*-reinterpret-cast)
+}
+
+void EventFD::clear()
+{
+  string counter( sizeof( uint64_t ), 0 );
+  read( counter ); // non-blocking: leaves `counter` empty if nothing was pending
+}
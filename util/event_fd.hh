@@ -0,0 +1,18 @@
+#pragma once
+
+#include "file_descriptor.hh"
+
+//! A FileDescriptor to an [eventfd](\ref man2::eventfd) counter, used to wake up a thread
+//! that is polling for it (e.g. in an EventLoop) from another thread.
+class EventFD : public FileDescriptor
+{
+public:
+  //! Create a non-blocking eventfd, initially unsignaled
+  EventFD();
+
+  //! Signal the eventfd (makes it readable until the next clear())
+  void notify();
+
+  //! Consume any pending signal (makes it unreadable until the next notify())
+  void clear();
+};
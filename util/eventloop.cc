@@ -3,7 +3,9 @@
 
 #include <cstring>
 #include <iostream>
+#include <sys/epoll.h>
 #include <sys/socket.h>
+#include <unistd.h>
 
 using namespace std;
 
@@ -38,6 +40,72 @@ EventLoop::FDRule::FDRule( BasicRule&& base,
   , error( move( s_error ) )
 {}
 
+EventLoop::GatedRules::GatedRules()
+  : epoll( CheckSystemCall( "epoll_create1", ::epoll_create1( EPOLL_CLOEXEC ) ) )
+{}
+
+void EventLoop::FDRule::set_enabled( const bool s_enabled )
+{
+  if ( not gate ) {
+    throw runtime_error( "set_enabled() called on a rule that has an interest function" );
+  }
+
+  if ( s_enabled == enabled or ( s_enabled and ( cancel_requested or fd.closed() ) ) ) {
+    return;
+  }
+
+  enabled = s_enabled;
+  if ( enabled ) {
+    ++gate->enabled;
+  } else {
+    --gate->enabled;
+  }
+
+  if ( epollable ) {
+    // The fd stays in the epoll set while the rule is disabled, waiting for no events (and EPOLLONESHOT, so that
+    // a hangup or error is reported at most once, and ignored), so each enable or disable is one EPOLL_CTL_MOD.
+    epoll_event event {};
+    event.events = enabled ? ( direction == Direction::In ? EPOLLIN : EPOLLOUT ) : EPOLLONESHOT;
+    event.data.ptr = this;
+    if ( registered ) {
+      CheckSystemCall( "epoll_ctl",
+                       ::epoll_ctl( gate->epoll.fd_num(), EPOLL_CTL_MOD, registered->fd_num(), &event ) );
+      return;
+    }
+
+    // epoll identifies a registration by its fd number, and several rules may watch the same fd
+    // (e.g. one for each direction), so each rule registers a duplicate fd number of its own.
+    registered.emplace( CheckSystemCall( "dup", ::dup( fd.fd_num() ) ) );
+    if ( 0 == ::epoll_ctl( gate->epoll.fd_num(), EPOLL_CTL_ADD, registered->fd_num(), &event ) ) {
+      return;
+    }
+    if ( errno != EPERM ) {
+      throw unix_error( "epoll_ctl" );
+    }
+
+    // epoll can't watch regular files (which are always ready anyway)
+    epollable = false;
+    registered.reset();
+  }
+
+  if ( enabled ) {
+    gate->files.push_back( this );
+  } else {
+    gate->files.remove( this );
+  }
+}
+
+void EventLoop::FDRule::unregister()
+{
+  set_enabled( false );
+  if ( registered ) {
+    // (Closing the duplicate fd wouldn't do: the registration lasts as long as the open file description.)
+    CheckSystemCall( "epoll_ctl",
+                     ::epoll_ctl( gate->epoll.fd_num(), EPOLL_CTL_DEL, registered->fd_num(), nullptr ) );
+    registered.reset();
+  }
+}
+
 EventLoop::RuleHandle EventLoop::add_rule( size_t category_id,
                                            FileDescriptor& fd,
                                            Direction direction,
@@ -69,12 +137,119 @@ EventLoop::RuleHandle EventLoop::add_rule( const size_t category_id,
   return RuleHandle { _non_fd_rules.back() };
 }
 
+EventLoop::RuleHandle EventLoop::add_gated_rule( size_t category_id,
+                                                 FileDescriptor& fd,
+                                                 Direction direction,
+                                                 const CallbackT& callback,
+                                                 const CallbackT& cancel, // NOLINT(*-easily-swappable-*)
+                                                 const CallbackT& error )
+{
+  if ( category_id >= _rule_categories.size() ) {
+    throw out_of_range( "bad category_id" );
+  }
+
+  if ( not _gated ) {
+    _gated = make_shared<GatedRules>();
+  }
+
+  _gated_rules.emplace_back(
+    make_shared<FDRule>( BasicRule { category_id, {}, callback }, fd.duplicate(), direction, cancel, error ) );
+  _gated_rules.back()->gate = _gated;
+
+  return RuleHandle { _gated_rules.back() };
+}
+
 void EventLoop::RuleHandle::cancel()
 {
   const shared_ptr<BasicRule> rule_shared_ptr = rule_weak_ptr_.lock();
   if ( rule_shared_ptr ) {
     rule_shared_ptr->cancel_requested = true;
   }
+
+  const shared_ptr<FDRule> fd_rule_shared_ptr = fd_rule_weak_ptr_.lock();
+  if ( fd_rule_shared_ptr and fd_rule_shared_ptr->gate ) {
+    fd_rule_shared_ptr->unregister();
+    fd_rule_shared_ptr->gate->cancellations = true;
+  }
+}
+
+void EventLoop::RuleHandle::set_enabled( const bool enabled )
+{
+  const shared_ptr<FDRule> fd_rule_shared_ptr = fd_rule_weak_ptr_.lock();
+  if ( fd_rule_shared_ptr ) {
+    fd_rule_shared_ptr->set_enabled( enabled );
+  } else if ( not rule_weak_ptr_.expired() ) {
+    throw runtime_error( "set_enabled() called on a rule without a file descriptor" );
+  }
+}
+
+void EventLoop::print_fd_error( const FDRule& rule ) const
+{
+  /* see if fd is a socket */
+  int socket_error = 0;
+  socklen_t optlen = sizeof( socket_error );
+  const int ret = getsockopt( rule.fd.fd_num(), SOL_SOCKET, SO_ERROR, &socket_error, &optlen );
+  if ( ret == -1 and errno == ENOTSOCK ) {
+    cerr << "error on polled file descriptor for rule \"" << _rule_categories.at( rule.category_id ).name << "\"\n";
+  } else if ( ret == -1 ) {
+    throw unix_error( "getsockopt" );
+  } else if ( optlen != sizeof( socket_error ) ) {
+    throw runtime_error( "unexpected length from getsockopt: " + to_string( optlen ) );
+  } else if ( socket_error ) {
+    cerr << "error on polled socket for rule \"" << _rule_categories.at( rule.category_id ).name
+         << "\": " << strerror( socket_error ) << "\n";
+  }
+}
+
+void EventLoop::remove_gated_rule( FDRule& rule )
+{
+  rule.cancel_requested = true;
+  rule.unregister();
+  rule.cancel();
+  _gated->cancellations = true; // (the rule is forgotten at the start of the next wait_next_event)
+}
+
+EventLoop::Result EventLoop::serve_gated_rule( FDRule& rule, const bool ready, const bool hangup, const bool error )
+{
+  if ( not rule.enabled ) {
+    return Result::Success; // (a hangup or error while it was disabled: it is reported again if it is enabled)
+  }
+
+  if ( error ) {
+    print_fd_error( rule );
+    rule.error();
+    remove_gated_rule( rule );
+    return Result::Success;
+  }
+
+  if ( hangup and ( ( not ready ) or ( rule.direction == Direction::Out ) ) ) {
+    // same as for polled rules: the fd is defunct
+    remove_gated_rule( rule );
+    return Result::Success;
+  }
+
+  if ( not ready ) {
+    return Result::Success;
+  }
+
+  const auto count_before = rule.service_count();
+  rule.callback();
+
+  if ( rule.cancel_requested ) {
+    return Result::Success;
+  }
+
+  if ( ( rule.direction == Direction::In and rule.fd.eof() ) or rule.fd.closed() ) {
+    remove_gated_rule( rule );
+    return Result::Success;
+  }
+
+  if ( count_before == rule.service_count() and rule.enabled ) {
+    throw runtime_error( "EventLoop: busy wait detected: rule \"" + _rule_categories.at( rule.category_id ).name
+                         + "\" did not read/write fd and is still enabled" );
+  }
+
+  return Result::Success;
 }
 
 // NOLINTBEGIN(*-cognitive-complexity)
@@ -112,6 +287,24 @@ EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
     }
   }
 
+  // forget gated rules that have been cancelled (they are no longer in the epoll set)
+  if ( _gated and _gated->cancellations ) {
+    _gated_rules.remove_if( []( const auto& rule ) { return rule->cancel_requested; } );
+    _gated->cancellations = false;
+  }
+
+  // gated rules on fds that are always ready (e.g. regular files) don't need to wait: serve one of them (they take
+  // turns), and then poll the rest without waiting, so that they are served too
+  bool served_file = false;
+  int poll_timeout_ms = timeout_ms;
+  if ( _gated and not _gated->files.empty() ) {
+    FDRule& this_rule = *_gated->files.front();
+    _gated->files.splice( _gated->files.end(), _gated->files, _gated->files.begin() );
+    serve_gated_rule( this_rule, true, false, false );
+    served_file = true;
+    poll_timeout_ms = 0;
+  }
+
   // now the file-descriptor-related rules. poll any "interested" file descriptors
   vector<pollfd> pollfds {};
   pollfds.reserve( _fd_rules.size() );
@@ -153,14 +346,20 @@ EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
     ++it;
   }
 
+  // the enabled gated rules are polled all at once, through their epoll set
+  const bool poll_gated = _gated and _gated->enabled > 0;
+  if ( poll_gated ) {
+    pollfds.push_back( { _gated->epoll.fd_num(), POLLIN, 0 } );
+  }
+
   // quit if there is nothing left to poll
-  if ( not something_to_poll ) {
-    return Result::Exit;
+  if ( not something_to_poll and not poll_gated ) {
+    return served_file ? Result::Success : Result::Exit;
   }
 
   // call poll -- wait until one of the fds satisfies one of the rules (writeable/readable)
-  if ( 0 == CheckSystemCall( "poll", ::poll( pollfds.data(), pollfds.size(), timeout_ms ) ) ) {
-    return Result::Timeout;
+  if ( 0 == CheckSystemCall( "poll", ::poll( pollfds.data(), pollfds.size(), poll_timeout_ms ) ) ) {
+    return served_file ? Result::Success : Result::Timeout;
   }
 
   // go through the poll results
@@ -170,22 +369,7 @@ EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
 
     const auto poll_error = static_cast<bool>( this_pollfd.revents & ( POLLERR | POLLNVAL ) );
     if ( poll_error ) {
-      /* see if fd is a socket */
-      int socket_error = 0;
-      socklen_t optlen = sizeof( socket_error );
-      const int ret = getsockopt( this_rule.fd.fd_num(), SOL_SOCKET, SO_ERROR, &socket_error, &optlen );
-      if ( ret == -1 and errno == ENOTSOCK ) {
-        cerr << "error on polled file descriptor for rule \"" << _rule_categories.at( this_rule.category_id ).name
-             << "\"\n";
-      } else if ( ret == -1 ) {
-        throw unix_error( "getsockopt" );
-      } else if ( optlen != sizeof( socket_error ) ) {
-        throw runtime_error( "unexpected length from getsockopt: " + to_string( optlen ) );
-      } else if ( socket_error ) {
-        cerr << "error on polled socket for rule \"" << _rule_categories.at( this_rule.category_id ).name
-             << "\": " << strerror( socket_error ) << "\n";
-      }
-
+      print_fd_error( this_rule );
       this_rule.error();
       this_rule.cancel();
       it = _fd_rules.erase( it );
@@ -221,6 +405,17 @@ EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
     ++it; // if we got here, it means we didn't call _fd_rules.erase()
   }
 
+  // finally, one of the gated rules that epoll says is ready (epoll takes care of fairness between them)
+  if ( poll_gated and ( pollfds.back().revents & POLLIN ) ) {
+    epoll_event event {};
+    if ( 1 == CheckSystemCall( "epoll_wait", ::epoll_wait( _gated->epoll.fd_num(), &event, 1, 0 ) ) ) {
+      auto& this_rule = *static_cast<FDRule*>( event.data.ptr );
+      const uint32_t wanted = this_rule.direction == Direction::In ? EPOLLIN : EPOLLOUT;
+      return serve_gated_rule(
+        this_rule, event.events & wanted, event.events & EPOLLHUP, event.events & EPOLLERR );
+    }
+  }
+
   return Result::Success;
 }
 // NOLINTEND(*-signed-bitwise)
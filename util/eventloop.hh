@@ -3,6 +3,7 @@
 #include <functional>
 #include <list>
 #include <memory>
+#include <optional>
 #include <poll.h>
 
 #include "file_descriptor.hh"
@@ -37,6 +38,19 @@ private:
     BasicRule( size_t s_category_id, InterestT s_interest, CallbackT s_callback );
   };
 
+  struct FDRule;
+
+  //! State shared between the EventLoop and its gated rules (so that a RuleHandle can enable or disable one)
+  struct GatedRules
+  {
+    FileDescriptor epoll;        //!< [epoll(7)](\ref man7::epoll) set of the gated rules (once enabled)
+    size_t enabled {};           //!< Number of enabled gated rules
+    std::list<FDRule*> files {}; //!< Enabled gated rules whose fds epoll can't watch (always ready)
+    bool cancellations {};       //!< Has a gated rule been cancelled through its RuleHandle?
+
+    GatedRules();
+  };
+
   struct FDRule : public BasicRule
   {
     FileDescriptor fd;   //!< FileDescriptor to monitor for activity.
@@ -44,6 +58,19 @@ private:
     CallbackT cancel;    //!< A callback that is called when the rule is cancelled (e.g. on EOF or hangup)
     CallbackT error;     //!< A callback that is called when the fd has an error before cancellation
 
+    //! \name
+    //! For gated rules only
+
+    //!@{
+    std::shared_ptr<GatedRules> gate {}; //!< The loop's gated rules (null for rules with an interest function)
+    std::optional<FileDescriptor> registered {}; //!< Separate fd number registered in the epoll set (once enabled)
+    bool enabled {};                             //!< Is the rule being watched?
+    bool epollable { true };                     //!< False if epoll refused the fd (e.g. a regular file)
+
+    void set_enabled( bool s_enabled );
+    void unregister(); //!< Disable the rule for good, and take its fd out of the epoll set
+    //!@}
+
     FDRule( BasicRule&& base, FileDescriptor&& s_fd, Direction s_direction, CallbackT s_cancel, CallbackT s_error );
 
     //! Returns the number of times fd has been read or written, depending on the value of Rule::direction.
@@ -54,6 +81,8 @@ private:
   std::vector<RuleCategory> _rule_categories {};
   std::list<std::shared_ptr<FDRule>> _fd_rules {};
   std::list<std::shared_ptr<BasicRule>> _non_fd_rules {};
+  std::list<std::shared_ptr<FDRule>> _gated_rules {};
+  std::shared_ptr<GatedRules> _gated {};
 
 public:
   EventLoop() { _rule_categories.reserve( 64 ); }
@@ -72,13 +101,21 @@ public:
   class RuleHandle
   {
     std::weak_ptr<BasicRule> rule_weak_ptr_;
+    std::weak_ptr<FDRule> fd_rule_weak_ptr_ {};
 
   public:
     template<class RuleType>
     explicit RuleHandle( const std::shared_ptr<RuleType> x ) : rule_weak_ptr_( x )
-    {}
+    {
+      if constexpr ( std::is_same_v<RuleType, FDRule> ) {
+        fd_rule_weak_ptr_ = x;
+      }
+    }
 
     void cancel();
+
+    //! Start or stop watching a rule added with add_gated_rule()
+    void set_enabled( bool enabled );
   };
 
   RuleHandle add_rule(
@@ -93,6 +130,18 @@ public:
   RuleHandle
   add_rule( size_t category_id, const CallbackT& callback, const InterestT& interest = [] { return true; } );
 
+  //! Add a rule without an interest function: it is watched only while enabled with RuleHandle::set_enabled()
+  //! (e.g. from a ByteStream watermark callback), and starts out disabled. Enabled gated rules are kept in an
+  //! [epoll(7)](\ref man7::epoll) set, so their cost to the loop scales with the number of ready fds
+  //! rather than with the number of rules.
+  RuleHandle add_gated_rule(
+    size_t category_id,
+    FileDescriptor& fd,
+    Direction direction,
+    const CallbackT& callback,
+    const CallbackT& cancel = [] {},
+    const CallbackT& error = [] {} );
+
   //! Calls [poll(2)](\ref man2::poll) and then executes callback for each ready fd.
   Result wait_next_event( int timeout_ms );
 
@@ -102,6 +151,22 @@ public:
   {
     return add_rule( add_category( name ), std::forward<Targs>( Fargs )... );
   }
+
+  template<typename... Targs>
+  auto add_gated_rule( const std::string& name, Targs&&... Fargs )
+  {
+    return add_gated_rule( add_category( name ), std::forward<Targs>( Fargs )... );
+  }
+
+private:
+  //! Print the error (if any) reported for a rule's fd
+  void print_fd_error( const FDRule& rule ) const;
+
+  //! Run a gated rule that is ready (or has hung up or failed)
+  Result serve_gated_rule( FDRule& rule, bool ready, bool hangup, bool error );
+
+  //! Cancel a gated rule from inside the loop (e.g. on EOF or hangup); it is forgotten on the next iteration
+  void remove_gated_rule( FDRule& rule );
 };
 
 using Direction = EventLoop::Direction;
@@ -2,6 +2,7 @@
 
 #include "exception.hh"
 
+#include <array>
 #include <fcntl.h>
 #include <iostream>
 #include <stdexcept>
@@ -151,7 +152,7 @@ void FileDescriptor::read( vector<string>& buffers )
 
 size_t FileDescriptor::write( string_view buffer )
 {
-  return write( vector<string_view> { buffer } );
+  return write( span<const string_view> { &buffer, 1 } );
 }
 
 size_t FileDescriptor::write( const vector<Ref<string>>& buffers )
@@ -166,21 +167,37 @@ size_t FileDescriptor::write( const vector<Ref<string>>& buffers )
 
 size_t FileDescriptor::write( const vector<string_view>& buffers )
 {
-  vector<iovec> iovecs;
-  iovecs.reserve( buffers.size() );
+  return write( span<const string_view> { buffers } );
+}
+
+size_t FileDescriptor::write( span<const string_view> buffers )
+{
+  // Small writes (the common case) build their iovecs on the stack
+  static constexpr size_t kInlineIovecs = 16;
+  array<iovec, kInlineIovecs> inline_iovecs {};
+  vector<iovec> heap_iovecs;
+  if ( buffers.size() > kInlineIovecs ) {
+    heap_iovecs.resize( buffers.size() );
+  }
+  const span<iovec> iovecs
+    = heap_iovecs.empty() ? span<iovec> { inline_iovecs }.first( buffers.size() ) : span<iovec> { heap_iovecs };
+
   size_t total_size = 0;
-  for ( const auto x : buffers ) {
-    iovecs.push_back( { const_cast<char*>( x.data() ), x.size() } ); // NOLINT(*-const-cast)
-    total_size += x.size();
+  for ( size_t i = 0; i < buffers.size(); ++i ) {
+    iovecs[i] = { const_cast<char*>( buffers[i].data() ), buffers[i].size() }; // NOLINT(*-const-cast)
+    total_size += buffers[i].size();
   }
 
   const ssize_t bytes_written
     = CheckSystemCall( "writev", ::writev( fd_num(), iovecs.data(), static_cast<int>( iovecs.size() ) ) );
-  register_write();
 
   if ( bytes_written == 0 and total_size != 0 ) {
+    if ( internal_fd_->non_blocking_ ) {
+      return 0; // (it would have blocked: nothing is written, e.g. a datagram is dropped, as by a full queue)
+    }
     throw runtime_error( "write returned 0 given non-empty input buffer" );
   }
+  register_write();
 
   if ( bytes_written > static_cast<ssize_t>( total_size ) ) {
     throw runtime_error( "write wrote more than length of input buffer" );
@@ -189,6 +206,32 @@ size_t FileDescriptor::write( const vector<string_view>& buffers )
   return bytes_written;
 }
 
+size_t FileDescriptor::splice_from( FileDescriptor& source, size_t len )
+{
+  // SPLICE_F_NONBLOCK only covers the pipe end(s); any other end blocks unless it was set non-blocking itself
+  const ssize_t bytes_moved = ::splice( // NOLINT(*-signed-bitwise)
+    source.fd_num(), nullptr, fd_num(), nullptr, len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK );
+  if ( bytes_moved < 0 ) {
+    if ( errno == EAGAIN ) {
+      return 0;
+    }
+    throw unix_error { "splice" };
+  }
+
+  source.register_read();
+  register_write();
+
+  if ( bytes_moved == 0 and len > 0 ) {
+    source.set_eof();
+  }
+
+  if ( bytes_moved > static_cast<ssize_t>( len ) ) {
+    throw runtime_error( "splice moved more than requested" );
+  }
+
+  return bytes_moved;
+}
+
 void FileDescriptor::set_blocking( bool blocking )
 {
   int flags = CheckSystemCall( "fcntl", fcntl( fd_num(), F_GETFL ) ); // NOLINT(*-vararg)
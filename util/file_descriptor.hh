@@ -3,6 +3,8 @@
 #include "ref.hh"
 #include <cstddef>
 #include <memory>
+#include <span>
+#include <string_view>
 #include <vector>
 
 // A reference-counted handle to a file descriptor
@@ -68,9 +70,15 @@ public:
   // Attempt to write a buffer
   // returns number of bytes written
   size_t write( std::string_view buffer );
+  size_t write( std::span<const std::string_view> buffers ); // gathers all buffers into one writev
   size_t write( const std::vector<std::string_view>& buffers );
   size_t write( const std::vector<Ref<std::string>>& buffers );
 
+  // Move up to `len` bytes from `source` into this file descriptor without copying them through user space
+  // (with [splice(2)](\ref man2::splice); one of the two must be a pipe)
+  // returns number of bytes moved: 0 at EOF on `source`, or if either end would block
+  size_t splice_from( FileDescriptor& source, size_t len );
+
   // Close the underlying file descriptor
   void close() { internal_fd_->close(); }
 
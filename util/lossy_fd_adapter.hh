@@ -7,6 +7,7 @@
 
 #include <optional>
 #include <random>
+#include <string>
 #include <utility>
 
 //! An adapter class that adds random dropping behavior to an FD adapter
@@ -40,9 +41,9 @@ public:
   //! \brief Read from the underlying AdapterT instance, potentially dropping the read datagram
   //! \returns std::optional<TCPSegment> that is empty if the segment was dropped or if
   //!          the underlying AdapterT returned an empty value
-  std::optional<TCPMessage> read()
+  std::optional<TCPMessage> read( std::string payload_buffer = {} )
   {
-    auto ret = _adapter.read();
+    auto ret = _adapter.read( std::move( payload_buffer ) );
     if ( _should_drop( false ) ) {
       return {};
     }
@@ -0,0 +1,287 @@
+#include "mirrored_buffer.hh"
+#include "exception.hh"
+#include "file_descriptor.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utility>
+
+using namespace std;
+
+namespace {
+uint64_t page_size()
+{
+  return static_cast<uint64_t>( CheckSystemCall( "sysconf", sysconf( _SC_PAGESIZE ) ) );
+}
+
+uint64_t round_up_to_page_size( uint64_t len )
+{
+  return ( len + page_size() - 1 ) / page_size() * page_size();
+}
+
+// An unlinked temporary file in `directory`
+FileDescriptor make_temporary_file( const string& directory )
+{
+  const int fd = open( directory.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600 ); // NOLINT(*-vararg)
+  if ( fd >= 0 ) {
+    return FileDescriptor { fd };
+  }
+
+  // Not every filesystem supports O_TMPFILE: create a named file and unlink it right away
+  string path = directory + "/minnow-ring-XXXXXX";
+  FileDescriptor file { CheckSystemCall( "mkstemp", mkostemp( path.data(), O_CLOEXEC ) ) };
+  CheckSystemCall( "unlink", unlink( path.c_str() ) );
+  return file;
+}
+
+void* checked_mmap( void* addr, size_t len, int prot, int flags, int fd ) // NOLINT(*-easily-swappable-*)
+{
+  void* ret = mmap( addr, len, prot, flags, fd, 0 );
+  if ( ret == MAP_FAILED ) { // NOLINT(*-cstyle-cast, *-int-to-ptr)
+    throw unix_error { "mmap" };
+  }
+  return ret;
+}
+} // namespace
+
+MirroredBuffer::MirroredBuffer( uint64_t min_size ) : size_( round_up_to_page_size( min_size ) )
+{
+  if ( size_ == 0 ) {
+    return;
+  }
+
+  // The backing store is an anonymous in-memory file. The descriptor can be closed as soon as the
+  // two views are mapped; the mappings keep the memory alive.
+  const FileDescriptor backing { CheckSystemCall( "memfd_create", memfd_create( "minnow-ring", MFD_CLOEXEC ) ) };
+  map( backing );
+}
+
+MirroredBuffer::MirroredBuffer( uint64_t min_size, const string& spill_directory )
+  : size_( round_up_to_page_size( min_size ) ), spill_directory_( spill_directory )
+{
+  if ( size_ == 0 ) {
+    return;
+  }
+
+  // The file is kept open for the residency hints (and reserve()). It starts out sparse: disk blocks
+  // are only allocated for pages as they are written.
+  file_.emplace( make_temporary_file( spill_directory_ ) );
+  map( *file_ );
+
+  // The ring is written and read front to back, so read ahead (and drop behind) aggressively.
+  madvise( base_, 2 * size_, MADV_SEQUENTIAL );
+}
+
+void MirroredBuffer::map( const FileDescriptor& backing )
+{
+  CheckSystemCall( "ftruncate", ftruncate( backing.fd_num(), static_cast<off_t>( size_ ) ) );
+
+  // Reserve 2 * size_ bytes of address space, then map the file over each half.
+  base_ = static_cast<char*>( checked_mmap( nullptr, 2 * size_, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1 ) );
+  try {
+    checked_mmap( base_, size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, backing.fd_num() );
+    checked_mmap( base_ + size_, size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, backing.fd_num() );
+  } catch ( ... ) {
+    release();
+    throw;
+  }
+}
+
+void MirroredBuffer::release()
+{
+  if ( base_ ) {
+    munmap( base_, 2 * size_ );
+    base_ = nullptr;
+  }
+}
+
+MirroredBuffer::~MirroredBuffer()
+{
+  release();
+}
+
+MirroredBuffer::MirroredBuffer( const MirroredBuffer& other )
+  : MirroredBuffer( other.file_backed() ? MirroredBuffer( other.size_, other.spill_directory_ )
+                                        : MirroredBuffer( other.size_ ) )
+{
+  if ( size_ ) {
+    reserve( 0, size_ );
+    memcpy( base_, other.base_, size_ );
+  }
+}
+
+MirroredBuffer& MirroredBuffer::operator=( const MirroredBuffer& other )
+{
+  if ( this != &other ) {
+    MirroredBuffer copy { other };
+    swap( base_, copy.base_ );
+    swap( size_, copy.size_ );
+    swap( file_, copy.file_ );
+    swap( spill_directory_, copy.spill_directory_ );
+    swap( reserved_begin_, copy.reserved_begin_ );
+    swap( reserved_end_, copy.reserved_end_ );
+  }
+  return *this;
+}
+
+MirroredBuffer::MirroredBuffer( MirroredBuffer&& other ) noexcept
+  : base_( exchange( other.base_, nullptr ) )
+  , size_( exchange( other.size_, 0 ) )
+  , file_( exchange( other.file_, nullopt ) )
+  , spill_directory_( move( other.spill_directory_ ) )
+  , reserved_begin_( exchange( other.reserved_begin_, 0 ) )
+  , reserved_end_( exchange( other.reserved_end_, 0 ) )
+{}
+
+MirroredBuffer& MirroredBuffer::operator=( MirroredBuffer&& other ) noexcept
+{
+  if ( this != &other ) {
+    release();
+    base_ = exchange( other.base_, nullptr );
+    size_ = exchange( other.size_, 0 );
+    file_ = exchange( other.file_, nullopt );
+    spill_directory_ = move( other.spill_directory_ );
+    reserved_begin_ = exchange( other.reserved_begin_, 0 );
+    reserved_end_ = exchange( other.reserved_end_, 0 );
+  }
+  return *this;
+}
+
+string_view MirroredBuffer::view( uint64_t pos, uint64_t len ) const
+{
+  if ( len == 0 ) {
+    return {};
+  }
+  if ( len > size_ ) {
+    throw out_of_range( "MirroredBuffer::view: length exceeds buffer size" );
+  }
+  return { base_ + pos % size_, len };
+}
+
+void MirroredBuffer::write( uint64_t pos, string_view data )
+{
+  if ( data.empty() ) {
+    return;
+  }
+  if ( data.size() > size_ ) {
+    throw out_of_range( "MirroredBuffer::write: data exceeds buffer size" );
+  }
+  reserve( pos, data.size() );
+  memcpy( base_ + pos % size_, data.data(), data.size() );
+}
+
+void MirroredBuffer::reserve( uint64_t pos, uint64_t len )
+{
+  if ( not file_ ) {
+    return;
+  }
+  const uint64_t begin = pos / page_size() * page_size();
+  const uint64_t end = round_up_to_page_size( pos + len );
+  if ( begin >= reserved_begin_ and end <= reserved_end_ ) {
+    return;
+  }
+
+  if ( begin >= reserved_begin_ and begin <= reserved_end_ ) {
+    // Growing past the end of the reserved pages: only the new ones need blocks
+    allocate( max( reserved_end_, end - min( end, size_ ) ), end );
+    reserved_begin_ = max( reserved_begin_, end - min( end, size_ ) );
+  } else {
+    allocate( begin, end );
+    reserved_begin_ = begin;
+  }
+  reserved_end_ = end;
+}
+
+void MirroredBuffer::allocate( uint64_t begin, uint64_t end )
+{
+  begin = max( begin, end - min( end, size_ ) );
+  const uint64_t first = begin % size_;
+  const uint64_t first_len = min( end - begin, size_ - first );
+
+  // (Storing to a page of the mapping with no disk block behind it would allocate one then, and with the disk
+  // full, the kernel could only report it with SIGBUS. Blocks that are already allocated are left as they are.)
+  const auto run = [&]( uint64_t offset, uint64_t run_len ) {
+    if ( fallocate(
+           file_->fd_num(), FALLOC_FL_KEEP_SIZE, static_cast<off_t>( offset ), static_cast<off_t>( run_len ) )
+           < 0
+         and errno != EOPNOTSUPP ) {
+      throw unix_error { "fallocate" };
+    }
+  };
+  run( first, first_len );
+  if ( first_len < end - begin ) {
+    run( 0, end - begin - first_len );
+  }
+}
+
+template<typename Action>
+void MirroredBuffer::for_each_page_run( uint64_t pos, uint64_t len, Action&& action ) const
+{
+  if ( not file_ or len == 0 ) {
+    return;
+  }
+  len = min( len, size_ );
+  const uint64_t begin = pos % size_;
+  const uint64_t first_len = min( len, size_ - begin );
+
+  const auto run = [&]( uint64_t offset, uint64_t run_len ) {
+    const uint64_t first_page = round_up_to_page_size( offset );
+    const uint64_t end_page = ( offset + run_len ) / page_size() * page_size();
+    if ( end_page > first_page ) {
+      action( first_page, end_page - first_page );
+    }
+  };
+  run( begin, first_len );
+  if ( first_len < len ) {
+    run( 0, len - first_len );
+  }
+}
+
+// The hints are advisory, so their errors are ignored: the worst case is that the pages stay in memory.
+
+void MirroredBuffer::evict( uint64_t pos, uint64_t len )
+{
+  for_each_page_run( pos, len, [&]( uint64_t offset, uint64_t run_len ) {
+    // Unmap the pages from both views (their contents stay in the page cache, marked dirty), start writing them
+    // back, and drop whichever of them are already clean. The rest are clean, reclaimable page cache once the
+    // write completes.
+    madvise( base_ + offset, run_len, MADV_DONTNEED );
+    madvise( base_ + size_ + offset, run_len, MADV_DONTNEED );
+    const auto file_offset = static_cast<off_t>( offset );
+    const auto file_len = static_cast<off_t>( run_len );
+    sync_file_range( file_->fd_num(), file_offset, file_len, SYNC_FILE_RANGE_WRITE );
+    posix_fadvise( file_->fd_num(), file_offset, file_len, POSIX_FADV_DONTNEED );
+  } );
+}
+
+void MirroredBuffer::prefetch( uint64_t pos, uint64_t len )
+{
+  for_each_page_run( pos, len, [&]( uint64_t offset, uint64_t run_len ) {
+    madvise( base_ + offset, run_len, MADV_WILLNEED );
+  } );
+}
+
+void MirroredBuffer::discard( uint64_t pos, uint64_t len )
+{
+  for_each_page_run( pos, len, [&]( uint64_t offset, uint64_t run_len ) {
+    fallocate( file_->fd_num(), // NOLINT(*-signed-bitwise)
+               FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+               static_cast<off_t>( offset ),
+               static_cast<off_t>( run_len ) );
+  } );
+
+  // The reserved pages no longer include the discarded ones: drop everything up to the end of the discarded
+  // range if it lies within the last size_ bytes reserved, and otherwise forget the reservation altogether
+  const uint64_t end = ( pos + min( len, size_ ) ) / page_size() * page_size();
+  if ( pos >= reserved_end_ - min( reserved_end_, size_ ) and end <= reserved_end_ ) {
+    reserved_begin_ = max( reserved_begin_, end );
+  } else {
+    reserved_begin_ = reserved_end_ = 0;
+  }
+}
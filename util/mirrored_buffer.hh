@@ -0,0 +1,73 @@
+#pragma once
+
+#include "file_descriptor.hh"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// A MirroredBuffer is a block of memory that is mapped twice, back to back, into the
+// process's address space: byte `i` and byte `i + size()` are the same byte. Any run of
+// up to size() bytes that starts within the first copy is therefore contiguous, which
+// makes this a ring buffer whose contents never have to be split at the wraparound point.
+class MirroredBuffer
+{
+public:
+  // Allocate a buffer of at least `min_size` bytes (rounded up to a multiple of the page size)
+  explicit MirroredBuffer( uint64_t min_size );
+
+  // Allocate a buffer backed by an unlinked temporary file in `spill_directory` instead of by memory, so that
+  // its pages can be written back and dropped (see evict()) while the bytes in them are still needed. The file
+  // is sparse, so write() reserves its disk blocks first, and throws (leaving the buffer as it was) if the disk
+  // is full. (On a filesystem that can't reserve blocks, a full disk would instead raise SIGBUS in write().)
+  MirroredBuffer( uint64_t min_size, const std::string& spill_directory );
+  ~MirroredBuffer();
+
+  // Copying makes a deep copy of the contents; moving transfers the mapping
+  MirroredBuffer( const MirroredBuffer& other );
+  MirroredBuffer& operator=( const MirroredBuffer& other );
+  MirroredBuffer( MirroredBuffer&& other ) noexcept;
+  MirroredBuffer& operator=( MirroredBuffer&& other ) noexcept;
+
+  uint64_t size() const { return size_; }
+
+  // View of `len` bytes beginning at ring position `pos` (taken modulo size()). `len` must not exceed size().
+  std::string_view view( uint64_t pos, uint64_t len ) const;
+
+  // Copy `data` into the ring beginning at ring position `pos` (taken modulo size()). For a file-backed buffer,
+  // throws unix_error if disk blocks can't be reserved for it.
+  void write( uint64_t pos, std::string_view data );
+
+  // Is the buffer backed by a file (rather than by memory)?
+  bool file_backed() const { return file_.has_value(); }
+
+  // Residency hints for the `len` bytes beginning at ring position `pos`. They only act on the pages that lie
+  // entirely within the range, and are no-ops for a buffer that isn't file-backed.
+  void evict( uint64_t pos, uint64_t len );    // still needed, but not soon: write back and drop from memory
+  void prefetch( uint64_t pos, uint64_t len ); // about to be read: start reading back in
+  void discard( uint64_t pos, uint64_t len );  // no longer needed: free the memory and the disk space
+
+private:
+  char* base_ {}; // start of the first of the two mappings (2 * size_ bytes are addressable)
+  uint64_t size_ {};
+  std::optional<FileDescriptor> file_ {}; // backing file (if not in memory)
+  std::string spill_directory_ {};
+  // Positions [reserved_begin_, reserved_end_) (page-aligned, and at most size_ apart) have disk blocks. They
+  // are offsets as the caller passes them, not taken modulo size_, so a caller that writes front to back only
+  // reserves blocks as the ring grows into new ones.
+  uint64_t reserved_begin_ {};
+  uint64_t reserved_end_ {};
+
+  void map( const FileDescriptor& backing );
+  void release();
+
+  // Allocate disk blocks for the pages that hold the `len` bytes beginning at ring position `pos` (if
+  // file-backed, and they aren't already reserved), so that storing to them through the mapping can't fail
+  void reserve( uint64_t pos, uint64_t len );
+  void allocate( uint64_t begin, uint64_t end ); // disk blocks for the pages in [begin, end)
+
+  // Call `action( offset, length )` for the whole pages within the range (at most two runs, if it wraps)
+  template<typename Action>
+  void for_each_page_run( uint64_t pos, uint64_t len, Action&& action ) const;
+};
@@ -74,10 +74,10 @@ void Parser::BufferList::dump_all( vector<Ref<std::string>>& out )
     return;
   }
   if ( skip_ ) {
-    out.emplace_back( buffer_.front()->substr( skip_ ) );
-  } else {
-    out.push_back( move( buffer_.front() ) );
+    buffer_.front()->erase( 0, skip_ ); // (in place: the buffer is owned, and this is cheaper than a new one)
+    skip_ = 0;
   }
+  out.push_back( move( buffer_.front() ) );
   buffer_.pop_front();
   for ( auto&& x : buffer_ ) {
     out.emplace_back( move( x ) );
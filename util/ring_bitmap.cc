@@ -0,0 +1,108 @@
+#include "ring_bitmap.hh"
+
+#include <algorithm>
+#include <bit>
+
+using namespace std;
+
+RingBitmap::RingBitmap( uint64_t size ) : words_( ( size + 63 ) / 64 ), size_( size ) {}
+
+template<typename Words, typename Action>
+void RingBitmap::for_each_word( Words& words, uint64_t size, uint64_t pos, uint64_t len, Action&& action )
+{
+  if ( size == 0 ) {
+    return;
+  }
+  len = min( len, size );
+  pos %= size;
+  while ( len > 0 ) {
+    const uint64_t bit = pos % 64;
+    const uint64_t count = min( { len, 64 - bit, size - pos } );
+    const uint64_t mask = ( count == 64 ? ~uint64_t {} : ( uint64_t { 1 } << count ) - 1 ) << bit;
+    if ( not action( words[pos / 64], mask ) ) {
+      return;
+    }
+    len -= count;
+    pos += count;
+    if ( pos == size ) {
+      pos = 0;
+    }
+  }
+}
+
+uint64_t RingBitmap::set( uint64_t pos, uint64_t len )
+{
+  uint64_t newly_set = 0;
+  for_each_word( words_, size_, pos, len, [&]( uint64_t& word, uint64_t mask ) {
+    newly_set += popcount( mask & ~word );
+    word |= mask;
+    return true;
+  } );
+  return newly_set;
+}
+
+void RingBitmap::clear( uint64_t pos, uint64_t len )
+{
+  for_each_word( words_, size_, pos, len, []( uint64_t& word, uint64_t mask ) {
+    word &= ~mask;
+    return true;
+  } );
+}
+
+uint64_t RingBitmap::length_of( bool value, uint64_t pos, uint64_t max_len ) const
+{
+  uint64_t run = 0;
+  for_each_word( words_, size_, pos, max_len, [&]( const uint64_t& word, uint64_t mask ) {
+    const uint64_t different = mask & ( value ? ~word : word );
+    if ( different == 0 ) {
+      run += popcount( mask );
+      return true;
+    }
+    run += countr_zero( different ) - countr_zero( mask ); // the bits before the first one that differs
+    return false;
+  } );
+  return run;
+}
+
+uint64_t RingBitmap::run_length_before( uint64_t pos, uint64_t max_len ) const
+{
+  if ( size_ == 0 ) {
+    return 0;
+  }
+  max_len = min( max_len, size_ );
+  pos %= size_;
+  uint64_t run = 0;
+  while ( run < max_len ) {
+    if ( pos == 0 ) {
+      pos = size_;
+    }
+    // the bits [pos - count, pos), in the word holding bit pos - 1
+    const uint64_t word_start = ( pos - 1 ) / 64 * 64;
+    const uint64_t count = min( max_len - run, pos - word_start );
+    const uint64_t top = pos - word_start - 1;
+    const uint64_t mask = ( count == 64 ? ~uint64_t {} : ( uint64_t { 1 } << count ) - 1 ) << ( top + 1 - count );
+    const uint64_t clear = mask & ~words_[word_start / 64];
+    if ( clear != 0 ) {
+      return run + top - ( 63 - countl_zero( clear ) ); // the bits after the last one that is clear
+    }
+    run += count;
+    pos -= count;
+  }
+  return run;
+}
+
+uint64_t RingBitmap::count_runs( uint64_t pos, uint64_t len ) const
+{
+  uint64_t runs = 0;
+  bool previous_set = false; // (the bit before the range counts as clear)
+  for_each_word( words_, size_, pos, len, [&]( const uint64_t& word, uint64_t mask ) {
+    const uint64_t bits = word & mask;
+    const uint64_t first_bit = mask & -mask;
+    const uint64_t last_bit = uint64_t { 1 } << ( 63 - countl_zero( mask ) );
+    // A run starts at each set bit whose predecessor is clear
+    runs += popcount( bits & ~( ( bits << 1 ) | ( previous_set ? first_bit : 0 ) ) );
+    previous_set = bits & last_bit;
+    return true;
+  } );
+  return runs;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// A RingBitmap is a fixed number of bits addressed by an ever-increasing position (taken modulo size()), for
+// keeping track of which positions of a sliding window (e.g. which bytes of a receive window) are present.
+// Ranges are handled a 64-bit word at a time.
+class RingBitmap
+{
+public:
+  explicit RingBitmap( uint64_t size );
+
+  uint64_t size() const { return size_; }
+
+  // Set the `len` bits beginning at `pos`; returns how many of them were not already set
+  uint64_t set( uint64_t pos, uint64_t len );
+
+  // Clear the `len` bits beginning at `pos`
+  void clear( uint64_t pos, uint64_t len );
+
+  // How many consecutive bits, beginning at `pos`, are set (looking at no more than `max_len` of them)?
+  uint64_t run_length( uint64_t pos, uint64_t max_len ) const { return length_of( true, pos, max_len ); }
+
+  // How many consecutive bits, beginning at `pos`, are clear (looking at no more than `max_len` of them)?
+  uint64_t gap_length( uint64_t pos, uint64_t max_len ) const { return length_of( false, pos, max_len ); }
+
+  // How many consecutive bits, ending just before `pos`, are set (looking at no more than `max_len` of them)?
+  uint64_t run_length_before( uint64_t pos, uint64_t max_len ) const;
+
+  // How many separate runs of set bits are there in the `len` bits beginning at `pos`?
+  uint64_t count_runs( uint64_t pos, uint64_t len ) const;
+
+private:
+  std::vector<uint64_t> words_;
+  uint64_t size_;
+
+  uint64_t length_of( bool value, uint64_t pos, uint64_t max_len ) const;
+
+  // Call `action( word, mask )` for the words covering the range (`mask` selects the range's bits in `word`)
+  // until it returns false. A range longer than size() is cut to size().
+  template<typename Words, typename Action>
+  static void for_each_word( Words& words, uint64_t size, uint64_t pos, uint64_t len, Action&& action );
+};
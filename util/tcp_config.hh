@@ -5,6 +5,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <limits>
 
 //! Config for TCP sender and receiver
 class TCPConfig
@@ -17,8 +18,59 @@ public:
 
   uint16_t rt_timeout = TIMEOUT_DFLT;      //!< Initial value of the retransmission timeout, in milliseconds
   size_t recv_capacity = DEFAULT_CAPACITY; //!< Receive capacity, in bytes
-  size_t send_capacity = DEFAULT_CAPACITY; //!< Sender capacity, in bytes
+  size_t send_capacity = DEFAULT_CAPACITY; //!< Sender capacity, in bytes (including those not yet acknowledged)
   Wrap32 isn { 137 };                      //!< Default initial sequence number
+
+  //! Compute the retransmission timeout from measured round-trip times (RFC 6298), starting from rt_timeout and
+  //! kept within [rto_min, rto_max] (backoff included), instead of always starting over from rt_timeout
+  bool adaptive_rto = false;
+  uint64_t rto_min = 10;    //!< Lower bound on the adaptive RTO, in milliseconds (one event-loop tick)
+  uint64_t rto_max = 60000; //!< Upper bound on the adaptive RTO, in milliseconds
+
+  //! Congestion control algorithms (None sends whatever the receiver's window allows)
+  enum class Congestion
+  {
+    None,
+    NewReno,
+    Cubic,
+  };
+  Congestion congestion_control = Congestion::None; //!< Bounds the sender's bytes in flight by a congestion window
+  //! Retransmit a segment as soon as three duplicate ACKs report it missing, and repair the rest of the window's
+  //! losses one per partial ACK (NewReno fast recovery, RFC 5681 and RFC 6582), rather than waiting for the RTO
+  bool fast_retransmit = false;
+  //! Ask the peer for selective acknowledgments (RFC 2018), and during fast recovery, retransmit just the
+  //! segments it reports missing
+  bool sack = false;
+  //! Offer the window scale option on the SYN (RFC 7323), so that a recv_capacity over 64 KiB can be advertised
+  bool window_scaling = false;
+  //! Offer the timestamps option on the SYN (RFC 7323): if the peer agrees, every segment carries a timestamp,
+  //! which the peer echoes, to measure RTTs (even of retransmissions) and to reject old duplicate segments (PAWS)
+  bool timestamps = false;
+  //! Pace new segments over the round trip (at the congestion window per smoothed RTT, times a gain of 2 in slow
+  //! start and 1.2 after), rather than sending all the window allows back to back
+  bool pacing = false;
+  //! Probe a zero window with empty segments from a persist timer, backing off exponentially (RFC 9293), rather
+  //! than by sending a byte into it and retransmitting that every RTO
+  bool persist_timer = false;
+  //! Reassemble in the receive stream's own buffer, using a bitmap
+  bool in_place_reassembly = false;
+
+  //! Caps on the out-of-order fragments the receiver holds (without in-place reassembly); past them, the
+  //! furthest-out fragments are dropped
+  size_t reassembly_max_fragments = std::numeric_limits<size_t>::max();
+  uint64_t reassembly_max_overhead_bytes = std::numeric_limits<uint64_t>::max();
+
+  static constexpr uint8_t MAX_WINDOW_SHIFT = 14; //!< Largest window scale shift count (RFC 7323)
+
+  //! The window scale shift count to offer: the smallest that lets all of recv_capacity be advertised
+  uint8_t window_shift() const
+  {
+    uint8_t shift = 0;
+    while ( shift < MAX_WINDOW_SHIFT and ( uint64_t { UINT16_MAX } << shift ) < recv_capacity ) {
+      shift++;
+    }
+    return shift;
+  }
 };
 
 //! Config for classes derived from FdAdapter
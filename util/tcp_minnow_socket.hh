@@ -3,6 +3,7 @@
 #include "eventloop.hh"
 #include "file_descriptor.hh"
 #include "socket.hh"
+#include "spsc_byte_stream.hh"
 #include "tcp_config.hh"
 #include "tcp_peer.hh"
 #include "tuntap_adapter.hh"
@@ -11,6 +12,7 @@
 #include <cstdint>
 #include <optional>
 #include <thread>
+#include <vector>
 
 //! Multithreaded wrapper around TCPPeer that approximates the Unix sockets API
 template<TCPDatagramAdapter AdaptT>
@@ -25,6 +27,19 @@ public:
   //! or else may wait foreever for remote peer to close the TCP connection.
   void wait_until_closed();
 
+  //! Exchange bytes with the TCPPeer thread through in-memory SPSCByteStreams instead of the socket pair
+  //! \note Must be called before connect() or listen_and_accept(). The owner then writes to outbound_writer()
+  //! and reads from inbound_reader() (polling their events if it needs to block), instead of using the socket.
+  void use_in_process_streams() { _in_process = true; }
+
+  //! \name
+  //! In-process streams (only after use_in_process_streams() and connect() or listen_and_accept())
+
+  //!@{
+  SPSCWriter& outbound_writer() { return _app_outbound.value().writer(); }
+  SPSCReader& inbound_reader() { return _app_inbound.value().reader(); }
+  //!@}
+
   //! Connect using the specified configurations; blocks until connect succeeds or fails
   void connect( const TCPConfig& c_tcp, const FdAdapterConfig& c_ad );
 
@@ -64,15 +79,29 @@ private:
   //! Stream socket for reads and writes between owner and TCP thread
   LocalStreamSocket _thread_data;
 
+  //! Lock-free streams between owner and TCP thread (replace _thread_data after use_in_process_streams())
+  bool _in_process { false };
+  std::optional<SPSCByteStream> _app_outbound {};
+  std::optional<SPSCByteStream> _app_inbound {};
+
   //! Set up the TCPPeer and the event loop
   void _initialize_TCP( const TCPConfig& config );
 
+  //! Set up the rules that move bytes between the TCPPeer and the in-process streams
+  void _initialize_in_process_streams( const TCPConfig& config );
+
   //! TCP state machine
   std::optional<TCPPeer> _tcp {};
 
+  //! Segments read from the network in one wakeup, for the TCPPeer to receive as a batch
+  std::vector<TCPMessage> _inbound_segments {};
+
   //! eventloop that handles all the events (new inbound datagram, new outbound bytes, new inbound bytes)
   EventLoop _eventloop {};
 
+  //! Rule that moves inbound bytes to the owner (enabled while the inbound stream has something to deliver)
+  std::optional<EventLoop::RuleHandle> _inbound_rule {};
+
   //! Process events while specified condition is true
   void _tcp_loop( const std::function<bool()>& condition );
 
@@ -2,15 +2,20 @@
 
 #include "exception.hh"
 
+#include <algorithm>
+#include <array>
 #include <cstddef>
 #include <exception>
 #include <iostream>
+#include <span>
 #include <stdexcept>
 #include <string>
 #include <sys/socket.h>
 #include <utility>
 
 static constexpr size_t TCP_TICK_MS = 10;
+static constexpr size_t TCP_MAX_IOV = 16;   // most views gathered into one write to the owner
+static constexpr size_t TCP_MAX_BURST = 64; // most segments read from the network in one wakeup
 
 inline uint64_t timestamp_ms()
 {
@@ -25,7 +30,12 @@ void TCPMinnowSocket<AdaptT>::_tcp_loop( const std::function<bool()>& condition
 {
   auto base_time = timestamp_ms();
   while ( condition() ) {
-    auto ret = _eventloop.wait_next_event( TCP_TICK_MS );
+    // (Wake up sooner if the sender's pacer will let a segment out before the next tick.)
+    uint64_t timeout_ms = TCP_TICK_MS;
+    if ( _tcp.has_value() ) {
+      timeout_ms = std::clamp<uint64_t>( _tcp->sender().pacing_delay_ms().value_or( TCP_TICK_MS ), 1, TCP_TICK_MS );
+    }
+    auto ret = _eventloop.wait_next_event( static_cast<int>( timeout_ms ) );
     if ( ret == EventLoop::Result::Exit or _abort ) {
       break;
     }
@@ -54,6 +64,7 @@ TCPMinnowSocket<AdaptT>::TCPMinnowSocket( std::pair<FileDescriptor, FileDescript
 {
   _thread_data.set_blocking( false );
   set_blocking( false );
+  _datagram_adapter.fd().set_blocking( false ); // (a burst is read until there is nothing more)
 }
 
 template<TCPDatagramAdapter AdaptT>
@@ -75,18 +86,33 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
   //    (needs to be read from the inbound_stream and written
   //    to the local stream socket back to the application)
 
-  // rule 1: read from filtered packet stream and dump into TCPConnection
+  // rule 1: read from filtered packet stream and dump into TCPConnection (everything that has arrived, up to
+  // a burst, as one batch)
   _eventloop.add_rule(
     "receive TCP segment from the network",
     _datagram_adapter.fd(),
     Direction::In,
     [&] {
-      if ( auto seg = _datagram_adapter.read() ) {
-        _tcp->receive( std::move( seg.value() ), [&]( auto x ) { _datagram_adapter.write( x ); } );
+      _inbound_segments.clear();
+      const FileDescriptor& fd = _datagram_adapter.fd();
+      while ( _inbound_segments.size() < TCP_MAX_BURST ) {
+        // (The payload is read into a buffer recycled from the inbound stream, which returns it when popped.)
+        auto buffer = _tcp->inbound_reader().chunk_pool().take( FileDescriptor::kReadBufferSize );
+        const auto reads = fd.read_count();
+        auto seg = _datagram_adapter.read( std::move( buffer ) );
+        if ( fd.read_count() == reads ) {
+          break; // (the fd is non-blocking, and had nothing more)
+        }
+        if ( seg ) {
+          _inbound_segments.push_back( std::move( seg.value() ) );
+        }
+      }
+      if ( not _inbound_segments.empty() ) {
+        _tcp->receive( std::span { _inbound_segments }, [&]( auto x ) { _datagram_adapter.write( x ); } );
       }
 
       // debugging output:
-      if ( _thread_data.eof() and _tcp.value().sender().sequence_numbers_in_flight() == 0 and not _fully_acked ) {
+      if ( _outbound_shutdown and _tcp.value().sender().sequence_numbers_in_flight() == 0 and not _fully_acked ) {
         std::cerr << "DEBUG: minnow outbound stream to " << _datagram_adapter.config().destination.to_string()
                   << " has been fully acknowledged.\n";
         _fully_acked = true;
@@ -94,6 +120,11 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
     },
     [&] { return _tcp->active(); } );
 
+  if ( _in_process ) {
+    _initialize_in_process_streams( config );
+    return;
+  }
+
   // rule 2: read from pipe into outbound buffer
   _eventloop.add_rule(
     "push bytes to TCPPeer",
@@ -132,7 +163,8 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
     } );
 
   // rule 3: read from inbound buffer into pipe
-  _eventloop.add_rule(
+  // (enabled and disabled by the inbound stream's reader watermark, rather than by an interest function)
+  _inbound_rule = _eventloop.add_gated_rule(
     "read bytes from inbound stream",
     _thread_data,
     Direction::Out,
@@ -142,30 +174,112 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
       // the pipe, handling the possibility of a partial
       // write (i.e., only pop what was actually written).
       if ( inbound.bytes_buffered() ) {
-        const std::string_view buffer = inbound.peek();
-        const auto bytes_written = _thread_data.write( buffer );
+        std::array<std::string_view, TCP_MAX_IOV> views {};
+        const auto count = inbound.peek_iov( views );
+        const auto bytes_written = _thread_data.write( std::span { views }.first( count ) );
         inbound.pop( bytes_written );
       }
 
       if ( inbound.is_finished() or inbound.has_error() ) {
         _thread_data.shutdown( SHUT_WR );
         _inbound_shutdown = true;
+        _inbound_rule->cancel();
 
         // debugging output:
         std::cerr << "DEBUG: minnow inbound stream from " << _datagram_adapter.config().destination.to_string()
                   << " finished " << ( inbound.has_error() ? "uncleanly.\n" : "cleanly.\n" );
       }
     },
-    [&] {
-      return _tcp->inbound_reader().bytes_buffered()
-             or ( ( _tcp->inbound_reader().is_finished() or _tcp->inbound_reader().has_error() )
-                  and not _inbound_shutdown );
-    },
     [&] {},
     [&] {
       std::cerr << "DEBUG: minnow inbound stream had error.\n";
       _tcp->inbound_reader().set_error();
     } );
+
+  _tcp->inbound_reader().set_reader_watermark( 0, [&]( bool ready ) { _inbound_rule->set_enabled( ready ); } );
+}
+
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowSocket<AdaptT>::_initialize_in_process_streams( const TCPConfig& config )
+{
+  _app_outbound.emplace( config.send_capacity, true );
+  _app_inbound.emplace( config.recv_capacity, true );
+
+  // Same as rules 2 and 3 above, but the owner's bytes arrive in (and leave through) SPSCByteStreams,
+  // and their eventfds take the place of the socket's readability and writability.
+
+  // rule 2: move bytes from the owner's outbound stream to the TCPPeer
+  _eventloop.add_rule(
+    "push bytes to TCPPeer",
+    _app_outbound->reader().readable_event(),
+    Direction::In,
+    [&] {
+      SPSCReader& app = _app_outbound->reader();
+      Writer& outbound = _tcp->outbound_writer();
+      // (The bytes are copied straight into the outbound stream's ring, with no string in between.)
+      while ( outbound.available_capacity() > 0 and app.bytes_buffered() > 0 ) {
+        const auto data = app.peek().substr( 0, outbound.available_capacity() );
+        outbound.write_ahead( 0, data );
+        outbound.commit( data.size() );
+        app.pop( data.size() );
+      }
+      app.acknowledge_event();
+
+      if ( app.is_finished() or app.has_error() ) {
+        if ( app.has_error() ) {
+          outbound.set_error();
+        }
+        outbound.close();
+        _outbound_shutdown = true;
+
+        // debugging output:
+        std::cerr << "DEBUG: minnow outbound stream to " << _datagram_adapter.config().destination.to_string()
+                  << " finished (" << _tcp.value().sender().sequence_numbers_in_flight() << " seqno"
+                  << ( _tcp.value().sender().sequence_numbers_in_flight() == 1 ? "" : "s" )
+                  << " still in flight).\n";
+      }
+
+      _tcp->push( [&]( auto x ) { _datagram_adapter.write( x ); } );
+    },
+    [&] {
+      return ( _tcp->active() ) and ( not _outbound_shutdown )
+             and ( _tcp->outbound_writer().available_capacity() > 0 );
+    } );
+
+  // rule 3: move bytes from the TCPPeer's inbound stream to the owner's
+  _eventloop.add_rule(
+    "read bytes from inbound stream",
+    _app_inbound->writer().writable_event(),
+    Direction::In,
+    [&] {
+      Reader& inbound = _tcp->inbound_reader();
+      SPSCWriter& app = _app_inbound->writer();
+      while ( inbound.bytes_buffered() > 0 ) {
+        const auto bytes_written = app.push( inbound.peek() );
+        if ( bytes_written == 0 ) {
+          break;
+        }
+        inbound.pop( bytes_written );
+      }
+      app.acknowledge_event();
+
+      if ( inbound.is_finished() or inbound.has_error() ) {
+        if ( inbound.has_error() ) {
+          app.set_error();
+        }
+        app.close();
+        _inbound_shutdown = true;
+
+        // debugging output:
+        std::cerr << "DEBUG: minnow inbound stream from " << _datagram_adapter.config().destination.to_string()
+                  << " finished " << ( inbound.has_error() ? "uncleanly.\n" : "cleanly.\n" );
+      }
+    },
+    [&] {
+      return ( not _inbound_shutdown )
+             and ( _tcp->inbound_reader().bytes_buffered() or _tcp->inbound_reader().is_finished()
+                   or _tcp->inbound_reader().has_error() );
+    } );
 }
 
 //! \brief Call [socketpair](\ref man2::socketpair) and return connected Unix-domain sockets of specified type
@@ -205,6 +319,9 @@ template<TCPDatagramAdapter AdaptT>
 void TCPMinnowSocket<AdaptT>::wait_until_closed()
 {
   shutdown( SHUT_RDWR );
+  if ( _app_outbound ) {
+    _app_outbound->writer().close();
+  }
   if ( _tcp_thread.joinable() ) {
     std::cerr << "DEBUG: minnow waiting for clean shutdown... ";
     _tcp_thread.join();
@@ -277,6 +394,9 @@ void TCPMinnowSocket<AdaptT>::_tcp_main()
     }
     _tcp_loop( [] { return true; } );
     shutdown( SHUT_RDWR );
+    if ( _app_inbound ) {
+      _app_inbound->writer().close();
+    }
     if ( not _tcp.value().active() ) {
       std::cerr << "DEBUG: minnow TCP connection finished "
                 << ( _tcp->inbound_reader().has_error() ? "uncleanly.\n" : "cleanly.\n" );
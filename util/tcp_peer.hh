@@ -7,8 +7,12 @@
 #include "tcp_sender.hh"
 #include "tcp_sender_message.hh"
 
+#include <algorithm>
+#include <concepts>
 #include <functional>
 #include <optional>
+#include <span>
+#include <vector>
 
 class TCPPeer
 {
@@ -23,16 +27,30 @@ public:
   Writer& outbound_writer() { return sender_.writer(); }
   Reader& inbound_reader() { return receiver_.reader(); }
 
-  /* Type of the `transmit` function that the push and tick methods can use to send messages */
+  /* Type of the `transmit` function that the push and tick methods can use to send messages. (They also take
+     any other callable, which is cheaper: no std::function to construct, or to call through.) */
   using TransmitFunction = std::function<void( TCPMessage )>;
 
   /* Passthrough methods */
-  void push( const TransmitFunction& transmit ) { sender_.push( make_send( transmit ) ); }
-  void tick( uint64_t t, const TransmitFunction& transmit )
+  template<std::invocable<TCPMessage> T>
+  void push( const T& transmit )
+  {
+    sender_.push( make_send( transmit ) );
+  }
+  void push( const TransmitFunction& transmit ) { push<TransmitFunction>( transmit ); }
+
+  template<std::invocable<TCPMessage> T>
+  void tick( uint64_t t, const T& transmit )
   {
     cumulative_time_ += t;
     sender_.tick( t, make_send( transmit ) );
+
+    // Has the application read enough to reopen a window the peer's sender is waiting on? Say so.
+    if ( advertised_ackno_.has_value() and receiver_.window_update_due( *advertised_ackno_, advertised_window_ ) ) {
+      send( sender_.make_empty_message(), transmit );
+    }
   }
+  void tick( uint64_t t, const TransmitFunction& transmit ) { tick<TransmitFunction>( t, transmit ); }
   bool has_ackno() const { return receiver_.send().ackno.has_value(); }
 
   /* Is the peer still active? */
@@ -48,6 +66,12 @@ public:
   }
 
   void receive( TCPMessage msg, const TransmitFunction& transmit )
+  {
+    receive<TransmitFunction>( std::move( msg ), transmit );
+  }
+
+  template<std::invocable<TCPMessage> T>
+  void receive( TCPMessage msg, const T& transmit )
   {
     if ( not active() ) {
       return;
@@ -56,49 +80,143 @@ public:
     // Record time in case this peer has to linger after streams finish.
     time_of_last_receipt_ = cumulative_time_;
 
+    // A segment older than the last one timestamped (PAWS, RFC 7323) is only acknowledged.
+    if ( receiver_.PAWS_reject( msg.sender.get() ) ) {
+      send( sender_.make_empty_message(), transmit );
+      return;
+    }
+
+    take_control_info( msg );
+    receiver_.receive( msg.sender.release() );
+    reply( transmit );
+  }
+
+  // Receive a burst of messages (e.g. everything read in one wakeup). Each is taken as by receive(), but their
+  // payloads go to the TCPReceiver as one batch, and the reply follows the whole burst.
+  void receive( std::span<TCPMessage> msgs, const TransmitFunction& transmit )
+  {
+    receive<TransmitFunction>( msgs, transmit );
+  }
+
+  template<std::invocable<TCPMessage> T>
+  void receive( std::span<TCPMessage> msgs, const T& transmit )
+  {
+    if ( not active() ) {
+      return;
+    }
+
+    time_of_last_receipt_ = cumulative_time_;
+
+    inbound_batch_.clear();
+    for ( auto& msg : msgs ) {
+      // (A segment that PAWS rejects is only acknowledged, by the reply.)
+      if ( receiver_.PAWS_reject( msg.sender.get() ) ) {
+        need_send_ = true;
+        continue;
+      }
+      take_control_info( msg );
+      inbound_batch_.push_back( msg.sender.release() );
+    }
+    receiver_.receive( inbound_batch_ );
+    reply( transmit );
+  }
+
+  // Receive-side reassembly statistics (see Reassembler::Stats)
+  Reassembler::Stats reassembly_stats() const { return receiver_.reassembly_stats(); }
+
+  // Testing interface
+  const TCPReceiver& receiver() const { return receiver_; }
+  const TCPSender& sender() const { return sender_; }
+
+private:
+  TCPConfig cfg_;
+  TCPSender sender_ { ByteStream { cfg_.send_capacity }, cfg_ };
+  TCPReceiver receiver_ { Reassembler {
+    ByteStream { cfg_.recv_capacity },
+    cfg_.in_place_reassembly ? Reassembler::Engine::Bitmap : Reassembler::Engine::Fragments,
+    { .max_fragments = cfg_.reassembly_max_fragments,
+      .max_overhead_bytes = cfg_.reassembly_max_overhead_bytes } } };
+
+  bool need_send_ {};
+  std::vector<TCPSenderMessage> inbound_batch_ {}; // (reused, for receive() of a burst)
+
+  // Take in everything from an incoming message but its payload: whether it needs a reply, the options
+  // negotiated by a SYN, and the acknowledgment (for the sender)
+  void take_control_info( TCPMessage& msg )
+  {
     // If SenderMessage occupies a sequence number, make sure to reply.
-    need_send_ |= ( msg.sender->sequence_length() > 0 );
+    const bool pure_ACK = msg.sender->sequence_length() == 0;
+    need_send_ |= not pure_ACK;
 
     // If SenderMessage is a "keep-alive" (with intentionally invalid seqno), make sure to reply.
     // (N.B. orthodox TCP rules require a reply on any unacceptable segment.)
     const auto our_ackno = receiver_.send().ackno;
     need_send_ |= ( our_ackno.has_value() and msg.sender->seqno + 1 == our_ackno.value() );
 
-    // Give incoming TCPSenderMessage to receiver.
-    receiver_.receive( std::move( msg.sender ) );
+    // Window scaling and timestamps (RFC 7323) are agreed on if both SYNs offer them. The window in a SYN
+    // segment is never scaled.
+    const bool SYN = msg.sender->SYN;
+    if ( SYN ) {
+      negotiate_window_scale( msg.sender->window_scale );
+      if ( not msg.sender->timestamp.has_value() ) {
+        sender_.disable_timestamps();
+      }
+    }
 
     // Give incoming TCPReceiverMessage to sender.
-    sender_.receive( msg.receiver );
+    if ( peer_window_shift_ > 0 and not SYN ) {
+      TCPReceiverMessage scaled = msg.receiver.get();
+      scaled.window_size <<= peer_window_shift_;
+      sender_.receive( scaled, pure_ACK );
+    } else {
+      sender_.receive( msg.receiver, pure_ACK );
+    }
+  }
 
+  void reply( const auto& transmit )
+  {
     // Send reply if needed.
     push( transmit );
     if ( need_send_ ) {
       send( sender_.make_empty_message(), transmit );
     }
 
-    // Did the inbound stream finish before the outbound stream? If so, no need to linger after streams finish.
-    if ( receiver_.writer().is_closed() and not std::as_const( sender_ ).reader().is_finished() ) {
+    // Did the inbound stream finish before we sent our FIN? If so, no need to linger after streams finish.
+    if ( receiver_.writer().is_closed() and not sender_.FIN_sent() ) {
       linger_after_streams_finish_ = false;
     }
   }
 
-  // Testing interface
-  const TCPReceiver& receiver() const { return receiver_; }
-  const TCPSender& sender() const { return sender_; }
-
-private:
-  TCPConfig cfg_;
-  TCPSender sender_ { ByteStream { cfg_.send_capacity }, cfg_.isn, cfg_.rt_timeout };
-  TCPReceiver receiver_ { Reassembler { ByteStream { cfg_.recv_capacity } } };
-
-  bool need_send_ {};
-
-  void send( const TCPSenderMessage& sender_message, const TransmitFunction& transmit )
+  void send( const TCPSenderMessage& sender_message, const auto& transmit )
   {
-    transmit( { borrow( sender_message ), receiver_.send() } );
+    // (The window is sent in 16 bits: scaled down, unless the segment carries a SYN.)
+    TCPReceiverMessage receiver_message = receiver_.send();
+    receiver_message.window_size = sender_message.SYN
+                                     ? std::min<uint32_t>( receiver_message.window_size, UINT16_MAX )
+                                     : receiver_message.window_size >> window_shift_;
+    advertised_ackno_ = receiver_message.ackno;
+    advertised_window_ = sender_message.SYN ? receiver_message.window_size
+                                            : uint64_t { receiver_message.window_size } << window_shift_;
+    transmit( TCPMessage { borrow( sender_message ), std::move( receiver_message ) } );
     need_send_ = false;
   }
 
+  void negotiate_window_scale( std::optional<uint8_t> peer_shift )
+  {
+    if ( not cfg_.window_scaling or not peer_shift.has_value() ) {
+      return;
+    }
+    peer_window_shift_ = std::min( *peer_shift, TCPConfig::MAX_WINDOW_SHIFT );
+    window_shift_ = cfg_.window_shift();
+    receiver_.scale_window( window_shift_ );
+  }
+
+  uint8_t window_shift_ {};      // applied to the windows we advertise
+  uint8_t peer_window_shift_ {}; // applied to the windows the peer advertises
+
+  std::optional<Wrap32> advertised_ackno_ {}; // the last ACK sent, and its window (as the peer will take it)
+  uint64_t advertised_window_ {};
+
   bool linger_after_streams_finish_ { true }; // one peer may need to linger to make sure all closure conditions met
   uint64_t cumulative_time_ {};
   uint64_t time_of_last_receipt_ {};
@@ -2,26 +2,45 @@
 
 #include "wrapping_integers.hh"
 
+#include <cstdint>
 #include <optional>
+#include <vector>
 
 /*
  * The TCPReceiverMessage structure contains the information sent from a TCP receiver to its sender.
  *
- * It contains three fields:
+ * It contains five fields:
  *
  * 1) The acknowledgment number (ackno): the *next* sequence number needed by the TCP Receiver.
  *    This is an optional field that is empty if the TCPReceiver hasn't yet received the Initial Sequence Number.
  *
  * 2) The window size. This is the number of sequence numbers that the TCP receiver is interested
  *    to receive, starting from the ackno if present. The maximum value is 65,535 (UINT16_MAX from
- *    the <cstdint> header).
+ *    the <cstdint> header), unless both sides agreed on window scaling: then it is 65,535 shifted left by the
+ *    receiver's window scale (and the TCPPeer shifts it back down for the segment's 16-bit field).
  *
  * 3) The RST (reset) flag. If set, the stream has suffered an error and the connection should be aborted.
+ *
+ * 4) The selective acknowledgment (SACK) blocks: up to four ranges of sequence numbers, beyond the ackno, that
+ *    the receiver already holds (RFC 2018). They are only sent to a TCPSender whose SYN said it could use them.
+ *
+ * 5) The timestamp echo (TSecr): the timestamp of the most recent segment received in order (RFC 7323), which
+ *    tells the TCPSender how long ago the segment that this acknowledges was sent.
  */
 
 struct TCPReceiverMessage
 {
   std::optional<Wrap32> ackno {};
-  uint16_t window_size {};
+  uint32_t window_size {};
   bool RST {};
+  std::optional<uint32_t> timestamp_echo {};
+
+  struct SACKBlock
+  {
+    Wrap32 begin; // first sequence number held
+    Wrap32 end;   // one past the last
+  };
+  std::vector<SACKBlock> SACK_blocks {}; // the most recently changed first
+
+  static constexpr size_t MAX_SACK_BLOCKS = 4; // (what fits in the 40 bytes of TCP options)
 };
@@ -3,12 +3,77 @@
 #include "helpers.hh"
 #include "wrapping_integers.hh"
 
+#include <algorithm>
 #include <sstream>
 
 using namespace std;
 
 static_assert( !( TCPSegment::HEADER_LENGTH & 0x03 ) ); // header length must be divisible by 4
 
+namespace {
+// TCP option kinds (RFC 9293, RFC 7323 and RFC 2018)
+constexpr uint8_t OPTION_END = 0;
+constexpr uint8_t OPTION_NOP = 1;
+constexpr uint8_t OPTION_WINDOW_SCALE = 3;
+constexpr uint8_t OPTION_SACK_PERMITTED = 4;
+constexpr uint8_t OPTION_SACK = 5;
+constexpr uint8_t OPTION_TIMESTAMPS = 8;
+constexpr uint8_t MAX_OPTIONS_LENGTH = 40;
+} // namespace
+
+void TCPSegment::parse_options( Parser& parser, uint8_t options_length )
+{
+  while ( options_length > 0 and not parser.has_error() ) {
+    uint8_t kind {};
+    parser.integer( kind );
+    options_length--;
+    if ( kind == OPTION_END ) {
+      break;
+    }
+    if ( kind == OPTION_NOP ) {
+      continue;
+    }
+
+    uint8_t length {};
+    parser.integer( length );
+    if ( length < 2 or length - 1 > options_length ) {
+      parser.set_error();
+      return;
+    }
+    options_length -= length - 1;
+    uint8_t body_length = length - 2;
+
+    if ( kind == OPTION_WINDOW_SCALE and body_length == 1 ) {
+      uint8_t shift {};
+      parser.integer( shift );
+      message.sender->window_scale = shift;
+    } else if ( kind == OPTION_TIMESTAMPS and body_length == 8 ) {
+      uint32_t value {};
+      uint32_t echo {};
+      parser.integer( value );
+      parser.integer( echo );
+      message.sender->timestamp = value;
+      if ( message.receiver->ackno.has_value() ) { // (the echo is only meaningful with an ACK)
+        message.receiver->timestamp_echo = echo;
+      }
+    } else if ( kind == OPTION_SACK_PERMITTED and body_length == 0 ) {
+      message.sender->SACK_permitted = true;
+    } else if ( kind == OPTION_SACK and body_length % 8 == 0 ) {
+      for ( ; body_length > 0; body_length -= 8 ) {
+        uint32_t begin {};
+        uint32_t end {};
+        parser.integer( begin );
+        parser.integer( end );
+        message.receiver->SACK_blocks.push_back( { Wrap32 { begin }, Wrap32 { end } } );
+      }
+    } else {
+      parser.remove_prefix( body_length ); // an option we don't use
+    }
+  }
+
+  parser.remove_prefix( options_length ); // (padding after the end of the option list)
+}
+
 void TCPSegment::parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum )
 {
   /* verify checksum */
@@ -44,16 +109,19 @@ void TCPSegment::parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum
   message.sender->SYN = octet & 0b0000'0010;
   message.sender->FIN = octet & 0b0000'0001;
 
-  parser.integer( message.receiver->window_size );
+  parser.integer( raw16 );
+  message.receiver->window_size = raw16; // (as sent: scaling is up to the TCPPeer)
   parser.integer( udinfo.cksum );
   parser.integer( raw16 ); // urgent pointer
 
-  // skip any options or anything extra in the header
   if ( data_offset < ( HEADER_LENGTH >> 2 ) ) {
     parser.set_error();
     return;
   }
-  parser.remove_prefix( data_offset * 4 - HEADER_LENGTH );
+  parse_options( parser, data_offset * 4 - HEADER_LENGTH );
+  if ( parser.has_error() ) {
+    return;
+  }
 
   parser.concatenate_all_remaining( message.sender->payload );
 }
@@ -64,20 +132,89 @@ public:
   uint32_t raw_value() const { return raw_value_; }
 };
 
+void TCPSegment::serialize_options( Serializer& serializer ) const
+{
+  // Each option is preceded by NOPs, to align it to four bytes
+  if ( message.sender->SYN and message.sender->window_scale.has_value() ) {
+    serializer.integer( OPTION_NOP );
+    serializer.integer( OPTION_WINDOW_SCALE );
+    serializer.integer( uint8_t { 3 } );
+    serializer.integer( *message.sender->window_scale );
+  }
+  if ( message.sender->SYN and message.sender->SACK_permitted ) {
+    serializer.integer( OPTION_NOP );
+    serializer.integer( OPTION_NOP );
+    serializer.integer( OPTION_SACK_PERMITTED );
+    serializer.integer( uint8_t { 2 } );
+  }
+
+  if ( message.sender->timestamp.has_value() ) {
+    serializer.integer( OPTION_NOP );
+    serializer.integer( OPTION_NOP );
+    serializer.integer( OPTION_TIMESTAMPS );
+    serializer.integer( uint8_t { 10 } );
+    serializer.integer( *message.sender->timestamp );
+    serializer.integer( message.receiver->timestamp_echo.value_or( 0 ) );
+  }
+
+  const auto& blocks = message.receiver->SACK_blocks;
+  const size_t SACK_blocks = SACK_blocks_to_send();
+  if ( SACK_blocks > 0 ) {
+    serializer.integer( OPTION_NOP );
+    serializer.integer( OPTION_NOP );
+    serializer.integer( OPTION_SACK );
+    serializer.integer( static_cast<uint8_t>( 2 + 8 * SACK_blocks ) );
+    for ( size_t i = 0; i < SACK_blocks; ++i ) {
+      serializer.integer( Wrap32Serializable { blocks[i].begin }.raw_value() );
+      serializer.integer( Wrap32Serializable { blocks[i].end }.raw_value() );
+    }
+  }
+}
+
+size_t TCPSegment::SACK_blocks_to_send() const
+{
+  if ( not message.receiver->ackno.has_value() ) {
+    return 0;
+  }
+  const size_t room = MAX_OPTIONS_LENGTH - fixed_options_length() - 4;
+  return min( message.receiver->SACK_blocks.size(), room / 8 );
+}
+
+uint8_t TCPSegment::fixed_options_length() const
+{
+  size_t length = message.sender->timestamp.has_value() ? 12 : 0;
+  if ( message.sender->SYN ) {
+    length += ( message.sender->window_scale.has_value() ? 4 : 0 ) + ( message.sender->SACK_permitted ? 4 : 0 );
+  }
+  return static_cast<uint8_t>( length );
+}
+
+uint8_t TCPSegment::options_length() const
+{
+  const size_t SACK_blocks = SACK_blocks_to_send();
+  return static_cast<uint8_t>( fixed_options_length() + ( SACK_blocks ? 4 + 8 * SACK_blocks : 0 ) );
+}
+
+uint8_t TCPSegment::header_length() const
+{
+  return HEADER_LENGTH + options_length();
+}
+
 void TCPSegment::serialize( Serializer& serializer ) const
 {
   serializer.integer( udinfo.src_port );
   serializer.integer( udinfo.dst_port );
   serializer.integer( Wrap32Serializable { message.sender->seqno }.raw_value() );
   serializer.integer( Wrap32Serializable { message.receiver->ackno.value_or( Wrap32 { 0 } ) }.raw_value() );
-  serializer.integer( uint8_t { ( HEADER_LENGTH >> 2 ) << 4 } ); // data offset
+  serializer.integer( static_cast<uint8_t>( ( header_length() >> 2 ) << 4 ) ); // data offset
   const bool reset = message.sender->RST or message.receiver->RST;
   const uint8_t flags = ( message.receiver->ackno.has_value() ? 0b0001'0000U : 0 ) | ( reset ? 0b0000'0100U : 0 )
                         | ( message.sender->SYN ? 0b0000'0010U : 0 ) | ( message.sender->FIN ? 0b0000'0001U : 0 );
   serializer.integer( flags );
-  serializer.integer( message.receiver->window_size );
+  serializer.integer( static_cast<uint16_t>( min<uint32_t>( message.receiver->window_size, UINT16_MAX ) ) );
   serializer.integer( udinfo.cksum );
   serializer.integer( uint16_t { 0 } ); // urgent pointer
+  serialize_options( serializer );
   serializer.buffer( message.sender->payload );
 }
 
@@ -100,6 +237,12 @@ string TCPSegment::to_string() const
   if ( message.sender->SYN ) {
     ss << " +SYN";
   }
+  if ( message.sender->SACK_permitted ) {
+    ss << " +SACK_PERMITTED";
+  }
+  if ( message.sender->window_scale.has_value() ) {
+    ss << " +WSCALE=" << static_cast<int>( *message.sender->window_scale );
+  }
   if ( not message.sender->payload.empty() ) {
     ss << " payload=\"" << pretty_print( message.sender->payload ) << "\"";
   }
@@ -113,6 +256,13 @@ string TCPSegment::to_string() const
   if ( ackno.has_value() ) {
     ss << " ACK<" << Wrap32Serializable { *ackno }.raw_value() << ">";
   }
+  if ( message.sender->timestamp.has_value() ) {
+    ss << " TS<" << *message.sender->timestamp << "," << message.receiver->timestamp_echo.value_or( 0 ) << ">";
+  }
+  for ( const auto& [begin, end] : message.receiver->SACK_blocks ) {
+    ss << " SACK<" << Wrap32Serializable { begin }.raw_value() << "-" << Wrap32Serializable { end }.raw_value()
+       << ">";
+  }
   ss << " winsize=" << message.receiver->window_size;
   ss << " src=" << udinfo.src_port << " dst=" << udinfo.dst_port;
   return ss.str();
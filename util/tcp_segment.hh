@@ -29,6 +29,17 @@ struct TCPSegment
 
   static constexpr uint8_t HEADER_LENGTH = 20; // TCP header length, not including options
 
+  uint8_t header_length() const; // including options
+
   // Return a string containing a summary in human-readable format
   std::string to_string() const;
+
+private:
+  // The options this implementation understands are SACK-permitted and SACK (RFC 2018), and window scale and
+  // timestamps (RFC 7323); others are skipped.
+  void parse_options( Parser& parser, uint8_t options_length );
+  void serialize_options( Serializer& serializer ) const;
+  uint8_t options_length() const;
+  uint8_t fixed_options_length() const; // (all but the SACK blocks, which get whatever room is left)
+  size_t SACK_blocks_to_send() const; // (as many as fit)
 };
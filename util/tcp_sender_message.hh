@@ -2,12 +2,14 @@
 
 #include "wrapping_integers.hh"
 
+#include <cstdint>
+#include <optional>
 #include <string>
 
 /*
  * The TCPSenderMessage structure contains the information sent from a TCP sender to its receiver.
  *
- * It contains five fields:
+ * It contains eight fields:
  *
  * 1) The sequence number (seqno) of the beginning of the segment. If the SYN flag is set, this is the
  *    sequence number of the SYN flag. Otherwise, it's the sequence number of the beginning of the payload.
@@ -20,6 +22,15 @@
  * 4) The FIN flag. If set, the payload represents the ending of the byte stream.
  *
  * 5) The RST (reset) flag. If set, the stream has suffered an error and the connection should be aborted.
+ *
+ * 6) The SACK-permitted flag (only meaningful with SYN). If set, the sender can make use of selective
+ *    acknowledgments, so the receiver may include SACK blocks in its TCPReceiverMessages (RFC 2018).
+ *
+ * 7) The window scale (only meaningful with SYN): the shift count that this side will apply to the window sizes
+ *    it advertises, if the other side's SYN carries one too (RFC 7323). Empty if the sender doesn't scale.
+ *
+ * 8) The timestamp (TSval): the sender's clock, in milliseconds, when the segment was sent, for the receiver to
+ *    echo back (RFC 7323). Empty unless both SYNs carried one.
  */
 
 struct TCPSenderMessage
@@ -32,6 +43,10 @@ struct TCPSenderMessage
 
   bool RST {};
 
+  bool SACK_permitted {};
+  std::optional<uint8_t> window_scale {};
+  std::optional<uint32_t> timestamp {};
+
   // How many sequence numbers does this segment use?
   size_t sequence_length() const { return SYN + payload.size() + FIN; }
 };
@@ -3,11 +3,12 @@
 
 using namespace std;
 
-optional<TCPMessage> TCPOverIPv4OverTunFdAdapter::read()
+optional<TCPMessage> TCPOverIPv4OverTunFdAdapter::read( string payload_buffer )
 {
   vector<string> strs( 3 );
   strs[0].resize( IPv4Header::LENGTH );
   strs[1].resize( TCPSegment::HEADER_LENGTH );
+  strs[2] = move( payload_buffer ); // (the read resizes it: no allocation if it has the room)
   _tun.read( strs );
 
   InternetDatagram ip_dgram;
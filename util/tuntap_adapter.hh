@@ -6,13 +6,14 @@
 #include "tun.hh"
 
 #include <optional>
+#include <string>
 #include <utility>
 
 template<class T>
-concept TCPDatagramAdapter = requires( T a, TCPMessage seg ) {
+concept TCPDatagramAdapter = requires( T a, TCPMessage seg, std::string buffer ) {
   { a.write( seg ) } -> std::same_as<void>;
 
-  { a.read() } -> std::same_as<std::optional<TCPMessage>>;
+  { a.read( std::move( buffer ) ) } -> std::same_as<std::optional<TCPMessage>>;
 };
 
 //! \brief A FD adapter for IPv4 datagrams read from and written to a TUN device
@@ -26,7 +27,8 @@ public:
   explicit TCPOverIPv4OverTunFdAdapter( TunFD&& tun ) : _tun( std::move( tun ) ) {}
 
   //! Attempts to read and parse an IPv4 datagram containing a TCP segment related to the current connection
-  std::optional<TCPMessage> read();
+  //! \param[in] payload_buffer is a spare string (e.g. from a ChunkPool) to read the payload into
+  std::optional<TCPMessage> read( std::string payload_buffer = {} );
 
   //! Creates an IPv4 datagram from a TCP segment and writes it to the TUN device
   void write( const TCPMessage& seg );